@@ -1,360 +1,712 @@
-#include <cstdio>
-#include <cstdint>
-#include <cstring>
-#include <array>
-#include <vector>
-#include <immintrin.h> 
-#include <chrono>  // ʱ
-
-using u8 = uint8_t;
-using u32 = uint32_t;
-using u64 = uint64_t;
-using namespace std::chrono;
-
-// ---------------------------
-// SM4 basic constants
-// ---------------------------
-static const u8 SM4_SBOX[256] = {
-    
-    0xd6,0x90,0xe9,0xfe,0xcc,0xe1,0x3d,0xb7,0x16,0xb6,0x14,0xc2,0x28,0xfb,0x2c,0x05,
-    0x2b,0x67,0x9a,0x76,0x2a,0xbe,0x04,0xc3,0xaa,0x44,0x13,0x26,0x49,0x86,0x06,0x99,
-    0x9c,0x42,0x50,0xf4,0x91,0xef,0x98,0x7a,0x33,0x54,0x0b,0x43,0xed,0xcf,0xac,0x62,
-    0xe4,0xb3,0x1c,0xa9,0xc9,0x08,0xe8,0x95,0x80,0xdf,0x94,0xfa,0x75,0x8f,0x3f,0xa6,
-    0x47,0x07,0xa7,0xfc,0xf3,0x73,0x17,0xba,0x83,0x59,0x3c,0x19,0xe6,0x85,0x4f,0xa8,
-    0x68,0x6b,0x81,0xb2,0x71,0x64,0xda,0x8b,0xf8,0xeb,0x0f,0x4b,0x70,0x56,0x9d,0x35,
-    0x1e,0x24,0x0e,0x5e,0x63,0x58,0xd1,0xa2,0x25,0x22,0x7c,0x3b,0x01,0x21,0x78,0x87,
-    0xd4,0x00,0x46,0x57,0x9f,0xd3,0x27,0x52,0x4c,0x36,0x02,0xe7,0xa0,0xc4,0xc8,0x9e,
-    0xea,0xbf,0x8a,0xd2,0x40,0xc7,0x38,0xb5,0xa3,0xf7,0xf2,0xce,0xf9,0x61,0x15,0xa1,
-    0xe0,0xae,0x5d,0xa4,0x9b,0x34,0x1a,0x55,0xad,0x93,0x32,0x30,0xf5,0x8c,0xb1,0xe3,
-    0x1d,0xf6,0xe2,0x2e,0x82,0x66,0xca,0x60,0xc0,0x29,0x23,0xab,0x0d,0x53,0x4e,0x6f,
-    0xd5,0xdb,0x37,0x45,0xde,0xfd,0x8e,0x2f,0x03,0xff,0x6a,0x72,0x6d,0x6c,0x5b,0x51,
-    0x8d,0x1b,0xaf,0x92,0xbb,0xdd,0xbc,0x7f,0x11,0xd9,0x5c,0x41,0x1f,0x10,0x5a,0xd8,
-    0x0a,0xc1,0x31,0x88,0xa5,0xcd,0x7b,0xbd,0x2d,0x74,0xd0,0x12,0xb8,0xe5,0xb4,0xb0,
-    0x89,0x69,0x97,0x4a,0x0c,0x96,0x77,0x7e,0x65,0xb9,0xf1,0x09,0xc5,0x6e,0xc6,0x84,
-    0x18,0xf0,0x7d,0xec,0x3a,0xdc,0x4d,0x20,0x79,0xee,0x5f,0x3e,0xd7,0xcb,0x39,0x48
-};
-
-static inline u32 rotl32(u32 x, int r) { return (x << r) | (x >> (32 - r)); }
-static inline u32 L_transform(u32 b) {
-    return b ^ rotl32(b, 2) ^ rotl32(b, 10) ^ rotl32(b, 18) ^ rotl32(b, 24);
-}
-static inline u32 tau(u32 a) {
-    u32 y = 0;
-    y |= (u32)SM4_SBOX[(a >> 24) & 0xFF] << 24;
-    y |= (u32)SM4_SBOX[(a >> 16) & 0xFF] << 16;
-    y |= (u32)SM4_SBOX[(a >> 8) & 0xFF] << 8;
-    y |= (u32)SM4_SBOX[(a) & 0xFF];
-    return y;
-}
-static inline u32 sm4_T(u32 x) {
-    return L_transform(tau(x));
-}
-
-static const u32 FK[4] = { 0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc };
-static const u32 CK[32] = {
-    0x00070e15,0x1c232a31,0x383f464d,0x545b6269,0x70777e85,0x8c939aa1,0xa8afb6bd,0xc4cbd2d9,
-    0xe0e7eef5,0xfc030a11,0x181f262d,0x343b4249,0x50575e65,0x6c737a81,0x888f969d,0xa4abb2b9,
-    0xc0c7ced5,0xdce3eaf1,0xf8ff060d,0x141b2229,0x30373e45,0x4c535a61,0x686f767d,0x848b9299,
-    0xa0a7aeb5,0xbcc3cad1,0xd8dfe6ed,0xf4fb0209,0x10171e25,0x2c333a41,0x484f565d,0x646b7279
-};
-
-void sm4_key_expand(const u8 key[16], u32 rk[32]) {
-    u32 MK[4];
-    for (int i = 0; i < 4; ++i) {
-        MK[i] = (u32(key[4 * i]) << 24) | (u32(key[4 * i + 1]) << 16) | (u32(key[4 * i + 2]) << 8) | u32(key[4 * i + 3]);
-    }
-    u32 K[4];
-    for (int i = 0; i < 4; ++i) K[i] = MK[i] ^ FK[i];
-    for (int i = 0; i < 32; ++i) {
-        u32 tmp = K[1] ^ K[2] ^ K[3] ^ CK[i];
-        u32 t = tau(tmp);
-        u32 rk_i = K[0] ^ (t ^ rotl32(t, 13) ^ rotl32(t, 23)); 
-        rk[i] = rk_i;
-      
-        K[0] = K[1]; K[1] = K[2]; K[2] = K[3]; K[3] = rk_i;
-    }
-}
-void sm4_encrypt_block(const u8 in[16], u8 out[16], const u32 rk[32]) {
-    u32 X[4];
-    for (int i = 0; i < 4; ++i) {
-        X[i] = (u32(in[4 * i]) << 24) | (u32(in[4 * i + 1]) << 16) | (u32(in[4 * i + 2]) << 8) | u32(in[4 * i + 3]);
-    }
-    for (int i = 0; i < 32; ++i) {
-        u32 tmp = X[1] ^ X[2] ^ X[3] ^ rk[i];
-        u32 t = sm4_T(tmp);
-        u32 newX = X[0] ^ t;
-        
-        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = newX;
-    }
-    
-    for (int i = 0; i < 4; ++i) {
-        u32 outw = X[3 - i];
-        out[4 * i + 0] = (u8)(outw >> 24);
-        out[4 * i + 1] = (u8)(outw >> 16);
-        out[4 * i + 2] = (u8)(outw >> 8);
-        out[4 * i + 3] = (u8)(outw);
-    }
-}
-
-// ---------------------------
-// T-table 
-// ---------------------------
-using ttable_t = std::array<u32, 256>;
-struct SM4_TTABLE {
-    ttable_t T0, T1, T2, T3;
-    void init_from_sbox() {
-        for (int b = 0; b < 256; ++b) {
-            u32 sb = (u32)SM4_SBOX[b];
-            u32 v = sb;
-         
-            u32 w0 = L_transform((u32)sb << 24);
-            u32 w1 = L_transform((u32)sb << 16);
-            u32 w2 = L_transform((u32)sb << 8);
-            u32 w3 = L_transform((u32)sb);
-            T0[b] = w0;
-            T1[b] = rotl32(w1, 8);
-            T2[b] = rotl32(w2, 16);
-            T3[b] = rotl32(w3, 24);
-        }
-    }
-} TTABLE;
-
-void sm4_encrypt_block_ttable(const u8 in[16], u8 out[16], const u32 rk[32]) {
-    u32 X[4];
-    for (int i = 0; i < 4; ++i) X[i] = (u32(in[4 * i]) << 24) | (u32(in[4 * i + 1]) << 16) | (u32(in[4 * i + 2]) << 8) | u32(in[4 * i + 3]);
-    for (int r = 0; r < 32; ++r) {
-        u32 a = X[1] ^ X[2] ^ X[3] ^ rk[r];
-
-        u8 b0 = (a >> 24) & 0xFF;
-        u8 b1 = (a >> 16) & 0xFF;
-        u8 b2 = (a >> 8) & 0xFF;
-        u8 b3 = a & 0xFF;
-        u32 t = TTABLE.T0[b0] ^ TTABLE.T1[b1] ^ TTABLE.T2[b2] ^ TTABLE.T3[b3];
-        u32 newX = X[0] ^ t;
-        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = newX;
-    }
-    for (int i = 0; i < 4; ++i) {
-        u32 outw = X[3 - i];
-        out[4 * i + 0] = (u8)(outw >> 24);
-        out[4 * i + 1] = (u8)(outw >> 16);
-        out[4 * i + 2] = (u8)(outw >> 8);
-        out[4 * i + 3] = (u8)(outw);
-    }
-}
-
-
-
-// ---------------------------
-// GHASH & SM4-GCM 
-// ---------------------------
-struct u128 { u64 hi; u64 lo; };
-static inline u128 xor128(const u128& a, const u128& b) { return { a.hi ^ b.hi, a.lo ^ b.lo }; }
-u128 gfmul128_slow(u128 X, u128 Y) {
-  
-    u128 Z{ 0,0 };
-  
-    for (int i = 0; i < 128; ++i) {
-        bool bit = ((i < 64) ? ((Y.lo >> i) & 1) : ((Y.hi >> (i - 64)) & 1));
-        if (bit) {
-          
-        }
-    }
-  
-    return { 0,0 };
-}
-void ghash_update(u128& X, const u8 block[16], const u128& H) {
-   
-    u128 B;
-    B.hi = ((u64)block[0] << 56) | ((u64)block[1] << 48) | ((u64)block[2] << 40) | ((u64)block[3] << 32) |
-        ((u64)block[4] << 24) | ((u64)block[5] << 16) | ((u64)block[6] << 8) | ((u64)block[7]);
-    B.lo = ((u64)block[8] << 56) | ((u64)block[9] << 48) | ((u64)block[10] << 40) | ((u64)block[11] << 32) |
-        ((u64)block[12] << 24) | ((u64)block[13] << 16) | ((u64)block[14] << 8) | ((u64)block[15]);
-    X = xor128(X, B);
- 
-    X = gfmul128_slow(X, H);
-}
-
-void sm4_gcm_encrypt(const u8 key[16], const u8 iv[12], const u8* plaintext, size_t plen,
-    const u8* aad, size_t aadlen,
-    u8* ciphertext, u8 tag_out[16])
-{
-    u32 rk[32];
-    sm4_key_expand(key, rk);
-   
-    u8 zero[16] = { 0 };
-    u8 Hblock[16];
-    sm4_encrypt_block(zero, Hblock, rk);
-    
-    u128 H;
-    H.hi = ((u64)Hblock[0] << 56) | ((u64)Hblock[1] << 48) | ((u64)Hblock[2] << 40) | ((u64)Hblock[3] << 32) |
-        ((u64)Hblock[4] << 24) | ((u64)Hblock[5] << 16) | ((u64)Hblock[6] << 8) | ((u64)Hblock[7]);
-    H.lo = ((u64)Hblock[8] << 56) | ((u64)Hblock[9] << 48) | ((u64)Hblock[10] << 40) | ((u64)Hblock[11] << 32) |
-        ((u64)Hblock[12] << 24) | ((u64)Hblock[13] << 16) | ((u64)Hblock[14] << 8) | ((u64)Hblock[15]);
-
-    // init GHASH
-    u128 X{0,0 };
-    size_t off = 0;
-    u8 block[16];
-    while (off + 16<= aadlen) {
-        memcpy(block, aad + off, 16 );
-        ghash_update
-        (X, block, H);
-        off +=16;
-    }
-    if
-        (off < aadlen) {
-        memset(block, 0, 16);
-        memcpy(block, aad + off, aadlen - off);
-        ghash_update(X, block, H);
-    }
-    u8 J0[16];
-    memcpy(J0, iv, 12 );
-    J0[12] = 0; J0[13] = 0; J0[14] = 0; J0[15] = 1;
-        auto inc32 = [](u8 ctr[16
-        ]) {
-                for (int i = 15; i >= 12; --i) {
-                    if (++ctr[i]) break;
-                }
-        };
-        u8 Sblock[ 16 ];
-        size_t i = 0 ;
-        u8 ctr[ 16 ];
-        memcpy(ctr, J0, 16
-        );
-        inc32(ctr); 
-        while (i + 16 <= plen) {
-            u8 keystream[16];
-            sm4_encrypt_block
-            (ctr, keystream, rk);
-            for (int j = 0; j < 16 ; ++j) ciphertext[i + j] = plaintext[i + j] ^ keystream[j];
-            // GHASH over ciphertext
-            ghash_update
-            (X, ciphertext + i, H);
-            inc32 (ctr);
-            i += 16;
-        }
-        if
-            (i < plen) {
-            u8 keystream[ 16 ];
-            sm4_encrypt_block
-            (ctr, keystream, rk);
-            size_t
-                rem = plen - i;
-            for (size_t j = 0 ; j < rem; ++j) ciphertext[i + j] = plaintext[i + j] ^ keystream[j];
-            // pad block and GHASH
-            memset(block, 0, 16 );
-            memcpy(block, ciphertext + i, rem);
-            ghash_update (X, block, H);
-        }
-        u8 lenblock[16] = { 0 };
-        u64 aadbits = (u64)aadlen * 8 ;
-        u64 ctxtbits = (u64)plen * 8 ;
-        for (int b = 0; b < 8; ++b) lenblock[7 - b] = (u8)(aadbits >> (8 * b));
-        for (int b = 0; b < 8; ++b) lenblock[15 - b] = (u8)(ctxtbits >> (8 * b));
-        ghash_update(X, lenblock, H);
-
-
-        sm4_encrypt_block(J0, Sblock, rk);
-       
-        u8 Xbytes[16];
-        for (int k = 0; k < 8; ++k) Xbytes[k] = (u8)(X.hi >> (56 - 8 * k));
-        for (int k = 0; k < 8; ++k) Xbytes[8 + k] = (u8)(X.lo >> (56 - 8 * k));
-        for (int k = 0; k < 16 ; ++k) tag_out[k] = Sblock[k] ^ Xbytes[k];
-
-}
-// ---------------------------
-// Чʲ߼
-// ---------------------------
-//  16 ֽڿܺʱʵ֣
-double measure_basic_efficiency(const u8 key[16], const u8 plain[16], int loop_count) {
-    u32 rk[32];
-    sm4_key_expand(key, rk);
-    u8 out[16];
-
-    auto start = high_resolution_clock::now();
-    for (int i = 0; i < loop_count; ++i) {
-        sm4_encrypt_block(plain, out, rk);
-    }
-    auto end = high_resolution_clock::now();
-    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0; // תΪ
-    // ֽܼ / ʱ = Ч (ֽ/)תΪ MB/s
-    return (loop_count * 16.0) / (1024 * 1024 * duration);
-}
-
-//  16 ֽڿܺʱT Ż
-double measure_ttable_efficiency(const u8 key[16], const u8 plain[16], int loop_count) {
-    u32 rk[32];
-    sm4_key_expand(key, rk);
-    TTABLE.init_from_sbox(); // ȷ T ʼ
-    u8 out[16];
-
-    auto start = high_resolution_clock::now();
-    for (int i = 0; i < loop_count; ++i) {
-        sm4_encrypt_block_ttable(plain, out, rk);
-    }
-    auto end = high_resolution_clock::now();
-    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
-    return (loop_count * 16.0) / (1024 * 1024 * duration);
-}
-
-//  SM4-GCM ģʽЧʣ֤ýϳķŴ죩
-double measure_gcm_efficiency(const u8 key[16], const u8 iv[12],
-    const u8* plaintext, size_t text_len,
-    int loop_count) {
-    std::vector<u8> cipher(text_len);
-    u8 tag[16];
-
-    auto start = high_resolution_clock::now();
-    for (int i = 0; i < loop_count; ++i) {
-        sm4_gcm_encrypt(key, iv, plaintext, text_len, nullptr, 0, cipher.data(), tag);
-    }
-    auto end = high_resolution_clock::now();
-    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
-    // ֽܼ = loop_count * text_len
-    return (loop_count * text_len * 1.0) / (1024 * 1024 * duration);
-}
-
-int main() {
-    // ʼ T 
-    TTABLE.init_from_sbox();
-
-    // Կ
-    u8 key[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,
-                  0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
-    u8 plain_block[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,
-                          0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
-    u8 iv[12] = { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
-                 0x08,0x09,0x0a,0x0b };
-
-    // ϳ GCM ԣ 1KB
-    const size_t large_text_len = 1024;
-    std::vector<u8> large_plain(large_text_len, 0x41); 
-
-    // ѭʵܵԽ߿ʵʱȶ
-    const int LOOP_BASIC = 100000;
-    const int LOOP_TTABLE = 100000;
-    const int LOOP_GCM = 100;
-
-    // Ч
-    double basic_mb_s = measure_basic_efficiency(key, plain_block, LOOP_BASIC);
-    double ttable_mb_s = measure_ttable_efficiency(key, plain_block, LOOP_TTABLE);
-    double gcm_mb_s = measure_gcm_efficiency(key, iv, large_plain.data(), large_text_len, LOOP_GCM);
-
-    printf("=== SM4 ЧʶԱ (MB/s) ===\n");
-    printf("ʵ:  %.2f MB/s\n", basic_mb_s);
-    printf("T Ż:  %.2f MB/s (Ż: %.2fx)\n",
-        ttable_mb_s, ttable_mb_s / basic_mb_s);
-    printf("SM4-GCM:   %.2f MB/s (֤ԽԺʱռԽ)\n", gcm_mb_s);
-
-    // ԭʼ֤ܽ
-    u32 rk[32];
-    sm4_key_expand(key, rk);
-    u8 ct_basic[16], ct_ttable[16];
-    sm4_encrypt_block(plain_block, ct_basic, rk);
-    sm4_encrypt_block_ttable(plain_block, ct_ttable, rk);
-    printf("\n֤ܽ (16 ֽڿ):\n");
-    printf(": "); for (int i = 0; i < 16; i++) printf("%02x", ct_basic[i]); printf("\n");
-    printf("T: "); for (int i = 0; i < 16; i++) printf("%02x", ct_ttable[i]); printf("\n");
-
-    return 0;
-}
+#include <chrono>  // 用于时间测量
+#include "sm4_gcm.h"
+
+using namespace std::chrono;
+
+// ---------------------------
+// 效率测量核心逻辑
+// ---------------------------
+// 测量单个 16 字节块加密耗时（基础实现）
+double measure_basic_efficiency(const u8 key[16], const u8 plain[16], int loop_count) {
+    u32 rk[32];
+    sm4_key_expand(key, rk);
+    u8 out[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < loop_count; ++i) {
+        sm4_encrypt_block(plain, out, rk);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0; // 转换为秒
+    // 总加密字节数 / 耗时 = 效率 (字节/秒)，再转换为 MB/s
+    return (loop_count * 16.0) / (1024 * 1024 * duration);
+}
+
+// 测量单个 16 字节块加密耗时（T 表优化）
+double measure_ttable_efficiency(const u8 key[16], const u8 plain[16], int loop_count) {
+    u32 rk[32];
+    sm4_key_expand(key, rk);
+    TTABLE.init_from_sbox(); // 确保 T 表初始化
+    u8 out[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < loop_count; ++i) {
+        sm4_encrypt_block_ttable(plain, out, rk);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return (loop_count * 16.0) / (1024 * 1024 * duration);
+}
+
+// 测量 SM4-GCM 模式效率（含认证，这里用较长明文放大差异）
+double measure_gcm_efficiency(const u8 key[16], const u8 iv[12],
+    const u8* plaintext, size_t text_len,
+    int loop_count) {
+    std::vector<u8> cipher(text_len);
+    u8 tag[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < loop_count; ++i) {
+        sm4_gcm_encrypt(key, iv, plaintext, text_len, nullptr, 0, cipher.data(), tag);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    // 总加密字节数 = loop_count * text_len
+    return (loop_count * text_len * 1.0) / (1024 * 1024 * duration);
+}
+
+// 小记录加密速率（条/秒）：reuse_key 为 false 时每条都从原始密钥开始，为 true 时复用 Sm4GcmKey
+double measure_gcm_records(const u8 key[16], const u8 iv[12], size_t rec_len, int count, bool reuse_key) {
+    std::vector<u8> rec(rec_len, 0x41), out(rec_len);
+    u8 aad[13] = { 0 };
+    u8 tag[16];
+    Sm4GcmKey gkey(key);
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        if (reuse_key) sm4_gcm_encrypt(gkey, iv, rec.data(), rec_len, aad, sizeof(aad), out.data(), tag);
+        else sm4_gcm_encrypt(key, iv, rec.data(), rec_len, aad, sizeof(aad), out.data(), tag);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return count / duration;
+}
+
+// 由 seg 字节的若干段组成的 rec_len 字节记录（段各自分配，如按 TCP 报文段接收的数据），原地加密：
+// 先拷贝到连续缓冲区加密再拷回，或直接用 sm4_gcm_encrypt_iov，返回 MB/s
+double measure_gcm_iov_records(const u8 key[16], const u8 iv[12], size_t rec_len, size_t seg, int count, bool use_iov) {
+    Sm4GcmKey gkey(key);
+    std::vector<std::vector<u8>> segs;
+    std::vector<Sm4IoVec> iov;
+    for (size_t off = 0; off < rec_len; off += seg)
+        segs.emplace_back(rec_len - off < seg ? rec_len - off : seg, (u8)0x41);
+    for (auto& v : segs) iov.push_back({ v.data(), v.size() });
+    std::vector<u8> staging(rec_len);
+    u8 aad[13] = { 0 };
+    u8 tag[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        if (use_iov) {
+            sm4_gcm_encrypt_iov(gkey, iv, iov.data(), iov.size(), aad, sizeof(aad), iov.data(), iov.size(), tag);
+            continue;
+        }
+        size_t off = 0;
+        for (const Sm4IoVec& v : iov) { memcpy(&staging[off], v.base, v.len); off += v.len; }
+        sm4_gcm_encrypt(gkey, iv, staging.data(), rec_len, aad, sizeof(aad), staging.data(), tag);
+        off = 0;
+        for (const Sm4IoVec& v : iov) { memcpy(v.base, &staging[off], v.len); off += v.len; }
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return (double)rec_len * count / (1024.0 * 1024.0) / duration;
+}
+
+// 同一密钥下 batch 条 rec_len 字节记录（各自 IV，13 字节 AAD）：逐条 sm4_gcm_encrypt 与
+// sm4_gcm_encrypt_batch 一次处理整批，返回每秒处理的记录数
+double measure_gcm_batch_records(const u8 key[16], size_t rec_len, size_t batch, int rounds, bool batched) {
+    Sm4GcmKey gkey(key);
+    std::vector<u8> ivs(12 * batch), pt(rec_len * batch, 0x41), ct(rec_len * batch), tags(16 * batch);
+    for (size_t m = 0; m < 12 * batch; ++m) ivs[m] = (u8)(m * 7 + 1);
+    u8 aad[13] = { 0 };
+    std::vector<Sm4GcmBatchItem> items(batch);
+    for (size_t m = 0; m < batch; ++m)
+        items[m] = { &ivs[12 * m], aad, sizeof(aad), &pt[rec_len * m], rec_len, &ct[rec_len * m], &tags[16 * m], false };
+
+    auto start = high_resolution_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        if (batched) sm4_gcm_encrypt_batch(gkey, items.data(), batch);
+        else for (size_t m = 0; m < batch; ++m)
+            sm4_gcm_encrypt(gkey, items[m].iv, items[m].in, rec_len, aad, sizeof(aad), items[m].out, items[m].tag);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return rounds * (double)batch / duration;
+}
+
+// 会话集中建立：已有 nkeys 个会话在用时又有 nkeys 个新会话同时建立。逐个构造到预先分配的
+// Sm4GcmKey 数组，或由 Sm4KeyCache::warm 一次装入（成组扩展并淘汰旧会话），返回每秒密钥数
+double measure_key_setup(size_t nkeys, bool cached) {
+    std::vector<u8> keys(16 * nkeys);
+    std::vector<u64> ids(nkeys);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (u8)(i * 131 + (i >> 9));
+    for (size_t i = 0; i < nkeys; ++i) ids[i] = i;
+    Sm4KeyCache cache(nkeys);
+    std::vector<Sm4GcmKey> ctx(cached ? 0 : nkeys);
+    if (cached) {
+        cache.warm(ids.data(), keys.data(), nkeys);
+        for (size_t i = 0; i < nkeys; ++i) ids[i] += nkeys;
+    }
+    for (Sm4GcmKey& k : ctx) k.init(keys.data());
+
+    auto start = high_resolution_clock::now();
+    if (cached) cache.warm(ids.data(), keys.data(), nkeys);
+    else for (size_t i = 0; i < nkeys; ++i) ctx[i].init(&keys[16 * i]);
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return nkeys / duration;
+}
+
+// 多个会话轮流发送 rec_len 字节记录：cache 为空时每条记录都用原始密钥调用，否则经 cache 取上下文
+// （命中统计留在 cache 中）。返回每秒记录数
+double measure_gcm_cached_records(size_t sessions, size_t rec_len, int count, Sm4KeyCache* cache) {
+    std::vector<u8> keys(16 * sessions), rec(rec_len, 0x41), out(rec_len);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (u8)(i * 131 + (i >> 9));
+    u8 iv[12] = { 0 }, aad[13] = { 0 }, tag[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        size_t s = (size_t)i % sessions;
+        if (cache) {
+            const Sm4KeyCacheEntry& e = cache->get(s, &keys[16 * s]);
+            sm4_gcm_encrypt(e.key, iv, rec.data(), rec_len, aad, sizeof(aad), out.data(), tag);
+        } else {
+            sm4_gcm_encrypt(&keys[16 * s], iv, rec.data(), rec_len, aad, sizeof(aad), out.data(), tag);
+        }
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return count / duration;
+}
+
+// 解密（含验证）与只验证两种方式处理 count 条 rec_len 字节记录的吞吐（MB/s）
+double measure_gcm_decrypt_efficiency(const u8 key[16], const u8 iv[12], size_t rec_len, int count, bool verify_only) {
+    Sm4GcmKey gkey(key);
+    std::vector<u8> pt(rec_len, 0x41), ct(rec_len), out(rec_len);
+    u8 tag[16];
+    sm4_gcm_encrypt(gkey, iv, pt.data(), rec_len, nullptr, 0, ct.data(), tag);
+    int ok = 0;
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        if (verify_only) ok += sm4_gcm_verify(gkey, iv, ct.data(), rec_len, nullptr, 0, tag);
+        else ok += sm4_gcm_decrypt(gkey, iv, ct.data(), rec_len, nullptr, 0, tag, out.data());
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    if (ok != count) printf("解密测试中标签验证失败\n");
+    return (count * (double)rec_len) / (1024 * 1024 * duration);
+}
+
+// 单条超长消息：单线程 sm4_gcm_encrypt 与多线程 sm4_gcm_encrypt_parallel，返回 MB/s
+double measure_gcm_parallel_efficiency(Sm4ThreadPool* pool, size_t len, int count) {
+    const u8 key[16] = { 0x2b,0x7e,0x15,0x16,0x28,0xae,0xd2,0xa6,0xab,0xf7,0x15,0x88,0x09,0xcf,0x4f,0x3c };
+    const u8 iv[12] = { 0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,0xde,0xca,0xf8,0x88 };
+    Sm4GcmKey gkey(key);
+    std::vector<u8> pt(len, 0x41), ct(len);
+    u8 aad[13] = { 0 };
+    u8 tag[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        if (pool) sm4_gcm_encrypt_parallel(*pool, gkey, iv, pt.data(), len, aad, sizeof(aad), ct.data(), tag);
+        else sm4_gcm_encrypt(gkey, iv, pt.data(), len, aad, sizeof(aad), ct.data(), tag);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    return (count * (double)len) / (1024 * 1024 * duration);
+}
+
+// 同一连接顺序发送 rec_len 字节的小消息（13 字节 AAD），每条的加密耗时（纳秒）：stats 为空时
+// 每条按需调用 sm4_gcm_encrypt；否则用 64 个槽位（每槽 1KB）的 Sm4GcmKeystreamRing，每 64 条之前
+// 在计时之外调用一次 fill（模拟空闲时预取），计时部分只剩异或与 GHASH，命中统计写入 stats
+double measure_gcm_prefetch_latency(size_t rec_len, int count, Sm4KeystreamStats* stats) {
+    const u8 key[16] = { 0x2b,0x7e,0x15,0x16,0x28,0xae,0xd2,0xa6,0xab,0xf7,0x15,0x88,0x09,0xcf,0x4f,0x3c };
+    const u8 iv0[12] = { 0xca,0xfe,0xba,0xbe,0xfa,0xce,0xdb,0xad,0xde,0xca,0xf8,0x88 };
+    Sm4GcmKey gkey(key);
+    Sm4GcmKeystreamRing ring(gkey, iv0, 64, 1024);
+    std::vector<u8> pt(rec_len, 0x41), ct(rec_len);
+    u8 aad[13] = { 0 };
+    u8 tag[16];
+    long long total_ns = 0;
+    int done = 0;
+    for (; done < count; done += 64) {
+        if (stats) ring.fill();
+        auto start = high_resolution_clock::now();
+        for (int i = 0; i < 64; ++i) {
+            if (stats) ring.encrypt(aad, sizeof(aad), pt.data(), ct.data(), rec_len, tag);
+            else {
+                u8 iv[12];
+                gcm_seq_iv(iv0, (u64)(done + i), iv);
+                sm4_gcm_encrypt(gkey, iv, pt.data(), rec_len, aad, sizeof(aad), ct.data(), tag);
+            }
+        }
+        total_ns += duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    }
+    if (stats) *stats = ring.stats();
+    return (double)total_ns / done;
+}
+
+// 单独测量 GHASH 内核吞吐（不含 SM4），buf_len 字节一次交给内核
+double measure_ghash_efficiency(ghash_blocks_fn fn, size_t buf_len, int loop_count) {
+    std::vector<u8> buf(buf_len, 0x5A);
+    GhashKey gk;
+    ghash_key_init(gk, u128{ 0x66e94bd4ef8a2c3bULL, 0x884cfa59ca342b2eULL }, GHASH_TABLE4 | GHASH_TABLE8);
+    u128 X{ 0, 0 };
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < loop_count; ++i) {
+        fn(X, buf.data(), buf_len / 16, gk);
+    }
+    auto end = high_resolution_clock::now();
+    double duration = duration_cast<microseconds>(end - start).count() / 1000000.0;
+    if (X.hi == 1 && X.lo == 2) printf(" ");  // 使用结果，防止循环被优化掉
+    return (loop_count * (double)buf_len) / (1024 * 1024 * duration);
+}
+
+// RFC 8998 附录 A.1 的 SM4-GCM 测试向量
+static void hex_to_bytes(const char* hex, std::vector<u8>& out) {
+    out.clear();
+    for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+        unsigned v;
+        sscanf(hex + i, "%2x", &v);
+        out.push_back((u8)v);
+    }
+}
+
+static bool sm4_gcm_known_answer_once() {
+    std::vector<u8> key, iv, aad, pt, ct, tag;
+    hex_to_bytes("0123456789ABCDEFFEDCBA9876543210", key);
+    hex_to_bytes("00001234567800000000ABCD", iv);
+    hex_to_bytes("FEEDFACEDEADBEEFFEEDFACEDEADBEEFABADDAD2", aad);
+    hex_to_bytes("AAAAAAAAAAAAAAAABBBBBBBBBBBBBBBBCCCCCCCCCCCCCCCCDDDDDDDDDDDDDDDD"
+        "EEEEEEEEEEEEEEEEFFFFFFFFFFFFFFFFEEEEEEEEEEEEEEEEAAAAAAAAAAAAAAAA", pt);
+    hex_to_bytes("17F399F08C67D5EE19D0DC9969C4BB7D5FD46FD3756489069157B282BB200735"
+        "D82710CA5C22F0CCFA7CBF93D496AC15A56834CBCF98C397B4024A2691233B8D", ct);
+    hex_to_bytes("83DE3541E4C2B58177E065A9BF7B62EC", tag);
+    std::vector<u8> out(pt.size());
+    u8 t[16];
+    sm4_gcm_encrypt(key.data(), iv.data(), pt.data(), pt.size(), aad.data(), aad.size(), out.data(), t);
+    if (out != ct || memcmp(t, tag.data(), 16) != 0) return false;
+
+    // 批量 CTR 接口从 inc32(J0) 开始应得到相同的密文
+    u32 rk[32];
+    sm4_key_expand(key.data(), rk);
+    u8 ctr[16];
+    memcpy(ctr, iv.data(), 12);
+    ctr[12] = 0; ctr[13] = 0; ctr[14] = 0; ctr[15] = 2;
+    sm4_ctr32_crypt(ctr, pt.data(), out.data(), pt.size(), rk);
+    if (out != ct) return false;
+
+    // 解密还原明文；只验证模式接受正确的标签
+    Sm4GcmKey gkey(key.data());
+    if (!sm4_gcm_decrypt(gkey, iv.data(), ct.data(), ct.size(), aad.data(), aad.size(), tag.data(), out.data())) return false;
+    if (out != pt) return false;
+    return sm4_gcm_verify(gkey, iv.data(), ct.data(), ct.size(), aad.data(), aad.size(), tag.data());
+}
+
+// 逐个强制本机支持的 SM4 内核重跑测试向量：H 与标签掩码 E(J0) 经各内核绑定的单分组路径计算
+bool sm4_gcm_known_answer_test() {
+    const Sm4KernelInfo* saved = SM4_DISPATCH.kernel;
+    bool ok = true;
+    for (int i = 0; i < SM4_KERNEL_COUNT && ok; ++i) {
+        if (!SM4_DISPATCH.select(SM4_KERNELS[i].name)) continue;
+        ok = sm4_gcm_known_answer_once();
+    }
+    SM4_DISPATCH.select(saved->name);
+    return ok;
+}
+
+// 篡改密文、AAD 或标签中的任一位都应被拒绝，且解密输出被清零；流式接口拒绝短于 12 字节的截断标签
+bool sm4_gcm_tamper_test() {
+    u8 key[16], iv[12];
+    for (int i = 0; i < 16; ++i) key[i] = (u8)(i * 17 + 1);
+    for (int i = 0; i < 12; ++i) iv[i] = (u8)(i * 5 + 2);
+    Sm4GcmKey gkey(key);
+    std::vector<u8> pt(333), aad(21), ct(pt.size()), out(pt.size());
+    for (size_t i = 0; i < pt.size(); ++i) pt[i] = (u8)(i * 7);
+    for (size_t i = 0; i < aad.size(); ++i) aad[i] = (u8)(i * 3);
+    u8 tag[16];
+    sm4_gcm_encrypt(gkey, iv, pt.data(), pt.size(), aad.data(), aad.size(), ct.data(), tag);
+
+    for (int which = 0; which < 3; ++which) {
+        std::vector<u8> c = ct, a = aad;
+        u8 t[16];
+        memcpy(t, tag, 16);
+        if (which == 0) c[200] ^= 0x01;
+        if (which == 1) a[20] ^= 0x80;
+        if (which == 2) t[15] ^= 0x01;
+        if (sm4_gcm_verify(gkey, iv, c.data(), c.size(), a.data(), a.size(), t)) return false;
+        memset(out.data(), 0xAA, out.size());
+        if (sm4_gcm_decrypt(gkey, iv, c.data(), c.size(), a.data(), a.size(), t, out.data())) return false;
+        for (u8 b : out) if (b != 0) return false;
+    }
+
+    // 流式接口的截断标签：12~16 字节的正确前缀通过，更短的长度即使前缀正确也拒绝
+    for (size_t n = 0; n <= 17; ++n) {
+        Sm4GcmCtx ctx;
+        ctx.init(gkey, iv, true);
+        ctx.update_aad(aad.data(), aad.size());
+        ctx.update_verify_only(ct.data(), ct.size());
+        if (ctx.verify(tag, n) != (n >= SM4_GCM_MIN_TAG_LEN && n <= 16)) return false;
+    }
+    return true;
+}
+
+// 批处理与逐条调用结果一致：长度混合（含超过一批容量的长记录、原地加密），
+// 其中一条篡改标签的记录须单独失败并清零，其余正常解密
+bool sm4_gcm_batch_test() {
+    u8 key[16];
+    for (int i = 0; i < 16; ++i) key[i] = (u8)(i * 29 + 3);
+    Sm4GcmKey gkey(key);
+    const size_t lens[] = { 0, 1, 15, 16, 17, 64, 300, 4100, 33, 0, 511, 48 };
+    const size_t n = sizeof(lens) / sizeof(lens[0]);
+    std::vector<std::vector<u8>> pt(n), buf(n), ref(n), out(n);
+    std::vector<u8> ivs(12 * n), tags(16 * n), ref_tags(16 * n), aad(19);
+    for (size_t i = 0; i < ivs.size(); ++i) ivs[i] = (u8)(i * 11);
+    for (size_t i = 0; i < aad.size(); ++i) aad[i] = (u8)(i + 0x30);
+    std::vector<Sm4GcmBatchItem> items(n);
+    for (size_t m = 0; m < n; ++m) {
+        pt[m].resize(lens[m]);
+        for (size_t i = 0; i < lens[m]; ++i) pt[m][i] = (u8)(i * 13 + m);
+        ref[m].resize(lens[m]);
+        size_t alen = m % aad.size();
+        sm4_gcm_encrypt(gkey, &ivs[12 * m], pt[m].data(), lens[m], aad.data(), alen, ref[m].data(), &ref_tags[16 * m]);
+        buf[m] = pt[m];
+        items[m] = { &ivs[12 * m], aad.data(), alen, buf[m].data(), lens[m], buf[m].data(), &tags[16 * m], false };
+    }
+    sm4_gcm_encrypt_batch(gkey, items.data(), n);
+    if (tags != ref_tags) return false;
+    for (size_t m = 0; m < n; ++m) {
+        if (buf[m] != ref[m]) return false;
+        out[m].assign(lens[m], 0xAA);
+        items[m].in = buf[m].data();
+        items[m].out = out[m].data();
+    }
+    tags[16 * 6 + 5] ^= 0x01;
+    if (sm4_gcm_decrypt_batch(gkey, items.data(), n)) return false;
+    for (size_t m = 0; m < n; ++m) {
+        if (items[m].ok != (m != 6)) return false;
+        if (m == 6) {
+            for (u8 b : out[m]) if (b != 0) return false;
+        } else if (out[m] != pt[m]) return false;
+    }
+    return true;
+}
+
+// 按 cuts 中的长度把 buf 切成段（最后一段取剩余部分）
+static std::vector<Sm4IoVec> gcm_split_iov(u8* buf, size_t len, const std::vector<size_t>& cuts) {
+    std::vector<Sm4IoVec> v;
+    size_t off = 0;
+    for (size_t c : cuts) {
+        if (off + c > len) break;
+        v.push_back({ buf + off, c });
+        off += c;
+    }
+    v.push_back({ buf + off, len - off });
+    return v;
+}
+
+// 分段接口与连续接口比对：输入输出段边界不同、含空段与 1 字节段、原地处理、篡改后清零全部输出段
+bool sm4_gcm_iov_test() {
+    u8 key[16], iv[12], aad[21];
+    for (int i = 0; i < 16; ++i) key[i] = (u8)(i * 17 + 5);
+    for (int i = 0; i < 12; ++i) iv[i] = (u8)(i * 3 + 1);
+    for (int i = 0; i < 21; ++i) aad[i] = (u8)(0x60 + i);
+    Sm4GcmKey gkey(key);
+    const size_t lens[] = { 0, 1, 15, 16, 17, 100, 257, 1500, 4099 };
+    const std::vector<size_t> in_cuts = { 1, 0, 15, 3, 29, 16, 64, 7, 200, 1, 1 };
+    const std::vector<size_t> out_cuts = { 16, 5, 0, 40, 1, 130, 33 };
+    for (size_t len : lens) {
+        std::vector<u8> pt(len), ref(len), ct(len, 0xAA), back(len, 0xAA);
+        for (size_t i = 0; i < len; ++i) pt[i] = (u8)(i * 7 + len);
+        u8 ref_tag[16], tag[16];
+        sm4_gcm_encrypt(gkey, iv, pt.data(), len, aad, sizeof(aad), ref.data(), ref_tag);
+
+        std::vector<Sm4IoVec> in = gcm_split_iov(pt.data(), len, in_cuts);
+        std::vector<Sm4IoVec> out = gcm_split_iov(ct.data(), len, out_cuts);
+        if (!sm4_gcm_encrypt_iov(gkey, iv, in.data(), in.size(), aad, sizeof(aad), out.data(), out.size(), tag)) return false;
+        if (ct != ref || memcmp(tag, ref_tag, 16) != 0) return false;
+
+        // 原地：同一缓冲区按两种不同的段划分作为输入与输出
+        std::vector<u8> buf = pt;
+        in = gcm_split_iov(buf.data(), len, out_cuts);
+        out = gcm_split_iov(buf.data(), len, in_cuts);
+        if (!sm4_gcm_encrypt_iov(gkey, iv, in.data(), in.size(), aad, sizeof(aad), out.data(), out.size(), tag)) return false;
+        if (buf != ref || memcmp(tag, ref_tag, 16) != 0) return false;
+        if (!sm4_gcm_decrypt_iov(gkey, iv, out.data(), out.size(), aad, sizeof(aad), tag, in.data(), in.size())) return false;
+        if (buf != pt) return false;
+
+        in = gcm_split_iov(ct.data(), len, in_cuts);
+        out = gcm_split_iov(back.data(), len, out_cuts);
+        tag[3] ^= 0x10;
+        if (sm4_gcm_decrypt_iov(gkey, iv, in.data(), in.size(), aad, sizeof(aad), tag, out.data(), out.size())) return false;
+        for (u8 b : back) if (b != 0) return false;
+    }
+    // 输入输出总长度不同
+    u8 a[32] = { 0 }, b[32], tag[16];
+    Sm4IoVec vin = { a, 32 }, vout = { b, 31 };
+    return !sm4_gcm_encrypt_iov(gkey, iv, &vin, 1, aad, sizeof(aad), &vout, 1, tag);
+}
+
+// 多线程 GCM 与单线程逐字节一致：长度跨越多个分段边界并带不足一块的尾部，AAD 长度不是 16 的倍数；
+// GHASH 分段合并与 ghash_update 串行链一致；篡改后拒绝并清零
+bool sm4_gcm_parallel_test() {
+    u8 key[16], iv[12], aad[29];
+    for (int i = 0; i < 16; ++i) key[i] = (u8)(i * 7 + 3);
+    for (int i = 0; i < 12; ++i) iv[i] = (u8)(0xF0 - i);
+    for (int i = 0; i < 29; ++i) aad[i] = (u8)(i * 5);
+    Sm4GcmKey gkey(key);
+    Sm4ThreadPool pool(4, false);
+    const size_t lens[] = { 0, 100, 16 * SM4_PARALLEL_MIN_BLOCKS * 2, 16 * SM4_PARALLEL_MIN_BLOCKS * 3 + 7,
+        16 * SM4_PARALLEL_MIN_BLOCKS * 5 + 16 * 300 + 1 };
+    for (size_t len : lens) {
+        std::vector<u8> pt(len), ref(len), ct(len), back(len);
+        for (size_t i = 0; i < len; ++i) pt[i] = (u8)(i * 131 + (i >> 10));
+        u8 ref_tag[16], tag[16];
+        sm4_gcm_encrypt(gkey, iv, pt.data(), len, aad, sizeof(aad), ref.data(), ref_tag);
+        sm4_gcm_encrypt_parallel(pool, gkey, iv, pt.data(), len, aad, sizeof(aad), ct.data(), tag);
+        if (ct != ref || memcmp(tag, ref_tag, 16) != 0) return false;
+        if (!sm4_gcm_decrypt_parallel(pool, gkey, iv, ct.data(), len, aad, sizeof(aad), tag, back.data()) || back != pt) return false;
+        if (len == 0) continue;
+        ct[len / 2] ^= 1;
+        if (sm4_gcm_decrypt_parallel(pool, gkey, iv, ct.data(), len, aad, sizeof(aad), tag, back.data())) return false;
+        for (u8 b : back) if (b != 0) return false;
+    }
+
+    // GHASH 分段合并 vs 逐块 ghash_update
+    const size_t nblocks = SM4_PARALLEL_MIN_BLOCKS * 3 + 77;
+    std::vector<u8> data(16 * nblocks);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (u8)(i * 29 + 1);
+    u128 X1{ 0x0123456789abcdefULL, 0x1122334455667788ULL }, X2 = X1;
+    for (size_t i = 0; i < nblocks; ++i) ghash_update(X1, &data[16 * i], gkey.gk.H);
+    ghash_blocks_parallel(pool, X2, data.data(), nblocks, gkey.gk);
+    if (X1.hi != X2.hi || X1.lo != X2.lo) return false;
+    // H^n 与逐次相乘一致
+    u128 P{ 1ULL << 63, 0 };
+    for (u64 n = 0; n < 40; ++n) {
+        u128 Q = ghash_h_pow(gkey.gk.H, n);
+        if (P.hi != Q.hi || P.lo != Q.lo) return false;
+        P = gfmul128_slow(P, gkey.gk.H);
+    }
+    return true;
+}
+
+// 密钥缓存：warm（含重复编号、已在缓存中的编号、不足 16 个的尾组）与 get 装入的轮密钥、H 与
+// 直接构造的 Sm4GcmKey 相同；erase 后其余项地址与内容不变，新密钥复用空出的槽位
+bool sm4_gcm_key_cache_test() {
+    const size_t n = 45;
+    std::vector<u8> keys(16 * n);
+    std::vector<u64> ids(n);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (u8)(i * 29 + 3);
+    for (size_t i = 0; i < n; ++i) ids[i] = 100 + i % 40;   // 后 5 个与前 5 个编号相同
+    Sm4KeyCache cache(64);
+    cache.get(105, &keys[16 * 5]);
+    if (cache.warm(ids.data(), keys.data(), n) != 39 || cache.size() != 40) return false;
+    auto same = [&](const Sm4KeyCacheEntry* e, size_t i) {
+        Sm4GcmKey ref(&keys[16 * i]);
+        u32 rk_dec[32];
+        sm4_key_expand_dec(&keys[16 * i], rk_dec);
+        return e && e->id == ids[i] && memcmp(e->key.rk, ref.rk, sizeof(ref.rk)) == 0 &&
+            memcmp(e->rk_dec, rk_dec, sizeof(rk_dec)) == 0 &&
+            e->key.gk.H.hi == ref.gk.H.hi && e->key.gk.H.lo == ref.gk.H.lo;
+    };
+    for (size_t i = 0; i < 40; ++i)
+        if (!same(cache.find(ids[i]), i)) return false;
+
+    const Sm4KeyCacheEntry* keep = cache.find(139);
+    cache.erase(101);
+    cache.erase(120);
+    if (cache.size() != 38 || cache.find(101) || cache.find(139) != keep || !same(keep, 39)) return false;
+    const u64 more[2] = { 500, 501 };
+    cache.warm(more, &keys[0], 2);
+    return cache.size() == 40 && cache.slots.size() == 40 && cache.find(139) == keep && same(keep, 39);
+}
+
+// 预取路径与按需计算逐字节一致：长度含 0、非整块、恰为槽位长度与超长（按需），穿插空闲补充与
+// 缓冲区耗尽；接收端篡改后拒绝并清零且序号照常前进；后台线程模式下结果同样一致且有命中
+bool sm4_gcm_keystream_test() {
+    u8 key[16], iv0[12], aad[13];
+    for (int i = 0; i < 16; ++i) key[i] = (u8)(i * 9 + 2);
+    for (int i = 0; i < 12; ++i) iv0[i] = (u8)(i * 17 + 5);
+    for (int i = 0; i < 13; ++i) aad[i] = (u8)i;
+    Sm4GcmKey gkey(key);
+    const size_t lens[] = { 0, 1, 15, 16, 17, 100, 255, 256, 257, 1000 };
+    const u64 first = 1000;
+    Sm4GcmKeystreamRing tx(gkey, iv0, 8, 256, first), rx(gkey, iv0, 8, 256, first);
+    for (int m = 0; m < 200; ++m) {
+        size_t len = lens[m % 10];
+        if (m % 13 == 0) tx.fill();
+        if (m % 7 == 0) rx.fill(3);
+        std::vector<u8> pt(len), ref(len), ct(len), back(len);
+        for (size_t i = 0; i < len; ++i) pt[i] = (u8)(i * 3 + m);
+        u8 iv[12], ref_tag[16], tag[16];
+        gcm_seq_iv(iv0, first + m, iv);
+        sm4_gcm_encrypt(gkey, iv, pt.data(), len, aad, sizeof(aad), ref.data(), ref_tag);
+        if (tx.encrypt(aad, sizeof(aad), pt.data(), ct.data(), len, tag) != first + m) return false;
+        if (ct != ref || memcmp(tag, ref_tag, 16) != 0) return false;
+        if (m % 11 == 5) {
+            tag[0] ^= 1;
+            if (rx.decrypt(aad, sizeof(aad), ct.data(), back.data(), len, tag)) return false;
+            for (u8 b : back) if (b != 0) return false;
+        } else if (!rx.decrypt(aad, sizeof(aad), ct.data(), back.data(), len, tag) || back != pt) return false;
+    }
+    Sm4KeystreamStats st = tx.stats();
+    if (st.hits == 0 || st.misses == 0 || st.oversize != 40 || st.hits + st.misses + st.oversize != 200) return false;
+
+    Sm4GcmKeystreamRing bg(gkey, iv0, 32, 256);
+    bg.start_background(4);
+    std::vector<u8> pt(200, 0x5A), ct(200), ref(200);
+    for (u64 m = 0; m < 2000; ++m) {
+        u8 iv[12], ref_tag[16], tag[16];
+        gcm_seq_iv(iv0, m, iv);
+        sm4_gcm_encrypt(gkey, iv, pt.data(), pt.size(), aad, sizeof(aad), ref.data(), ref_tag);
+        bg.encrypt(aad, sizeof(aad), pt.data(), ct.data(), pt.size(), tag);
+        if (ct != ref || memcmp(tag, ref_tag, 16) != 0) return false;
+        if (m % 64 == 0) std::this_thread::yield();
+    }
+    bg.stop_background();
+    return bg.stats().hits > 0;
+}
+
+int main() {
+    // 探测 CPU，选择 SM4 与 GHASH 内核（环境变量 SM4_KERNEL / GHASH_KERNEL 可强制指定）
+    if (!SM4_DISPATCH.init()) {
+        printf("S盒查找表构造失败\n");
+        return 1;
+    }
+    GHASH_DISPATCH.init();
+
+    // 测试密钥、明文
+    u8 key[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,
+                  0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
+    u8 plain_block[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,
+                          0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
+    u8 iv[12] = { 0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
+                 0x08,0x09,0x0a,0x0b };
+
+    // 构造较长明文用于 GCM 测试（比如 1KB）
+    const size_t large_text_len = 1024;
+    std::vector<u8> large_plain(large_text_len, 0x41); 
+
+    // 循环次数：根据实际性能调整，性能越高可适当增大，让时间测量更稳定
+    const int LOOP_BASIC = 100000;
+    const int LOOP_TTABLE = 100000;
+    const int LOOP_GCM = 2000;
+
+    // 测量并输出效率
+    double basic_mb_s = measure_basic_efficiency(key, plain_block, LOOP_BASIC);
+    double ttable_mb_s = measure_ttable_efficiency(key, plain_block, LOOP_TTABLE);
+    double gcm_mb_s = measure_gcm_efficiency(key, iv, large_plain.data(), large_text_len, LOOP_GCM);
+
+    printf("=== SM4 加密效率对比 (MB/s) ===\n");
+    printf("基础实现:  %.2f MB/s\n", basic_mb_s);
+    printf("T 表优化:  %.2f MB/s (优化倍数: %.2fx)\n",
+        ttable_mb_s, ttable_mb_s / basic_mb_s);
+    printf("SM4-GCM:   %.2f MB/s (含认证，数据越长相对耗时占比越低，GHASH 内核: %s)\n",
+        gcm_mb_s, GHASH_DISPATCH.kernel->name);
+    // 各 GHASH 内核：单独的吞吐，以及与 SM4 T 表等共用 L1 时的整体 GCM 吞吐
+    // （table8 每个密钥 4KB 表 + 2KB 约简表，table4 为 256 字节 + 128 字节）
+    u32 cpu = sm4_cpu_features();
+    const GhashKernelInfo* selected = GHASH_DISPATCH.kernel;
+    // 在默认内核下建好的密钥，切换到各内核后的标签应与切换后新建的密钥相同
+    Sm4GcmKey early_key(key);
+    u8 probe_ct[100], early_tag[16], fresh_tag[16];
+    for (const GhashKernelInfo& k : GHASH_KERNELS) {
+        if ((cpu & k.need) != k.need) {
+            printf("GHASH %-8s 本机不支持\n", k.name);
+            continue;
+        }
+        double v = measure_ghash_efficiency(k.blocks, 16 * 1024, k.blocks == ghash_blocks_generic ? 16 : 4096);
+        GHASH_DISPATCH.select(k.name);
+        double g = measure_gcm_efficiency(key, iv, large_plain.data(), large_text_len, LOOP_GCM / 4);
+        Sm4GcmKey fresh_key(key);
+        sm4_gcm_encrypt(early_key, iv, large_plain.data(), sizeof(probe_ct), large_plain.data(), 13, probe_ct, early_tag);
+        sm4_gcm_encrypt(fresh_key, iv, large_plain.data(), sizeof(probe_ct), large_plain.data(), 13, probe_ct, fresh_tag);
+        printf("GHASH %-8s %.2f MB/s，SM4-GCM %.2f MB/s，与逐位乘法比对: %s，切换前建的密钥: %s\n", k.name, v, g,
+            GHASH_DISPATCH_TABLE::self_check(k.blocks) ? "一致" : "不一致",
+            memcmp(early_tag, fresh_tag, 16) == 0 ? "一致" : "不一致");
+    }
+    GHASH_DISPATCH.select(selected->name);
+
+    const size_t dec_lens[] = { 1024, 64 * 1024 };
+    for (size_t n : dec_lens) {
+        int count = (int)((64u << 20) / n);
+        double dec = measure_gcm_decrypt_efficiency(key, iv, n, count, false);
+        double ver = measure_gcm_decrypt_efficiency(key, iv, n, count, true);
+        printf("SM4-GCM %5zu 字节: 解密并验证 %.2f MB/s，只验证 %.2f MB/s (%.2fx)\n", n, dec, ver, ver / dec);
+    }
+
+    // 同一密钥反复加密小记录（13 字节 AAD）：每次重建密钥 vs 复用 Sm4GcmKey
+    const size_t rec_lens[] = { 64, 256, 1024 };
+    for (size_t n : rec_lens) {
+        double per_call = measure_gcm_records(key, iv, n, 100000, false);
+        double reused = measure_gcm_records(key, iv, n, 100000, true);
+        printf("SM4-GCM %4zu 字节记录: 每次建密钥 %.0f 条/秒，复用 Sm4GcmKey %.0f 条/秒 (%.2fx)\n",
+            n, per_call, reused, reused / per_call);
+    }
+
+    // 故障切换后 4096 个会话同时建立：逐个构造 Sm4GcmKey 与缓存成组装入
+    double setup_each = measure_key_setup(4096, false);
+    double setup_warm = measure_key_setup(4096, true);
+    printf("4096 个密钥建立: 逐个构造 %.0f 个/秒，Sm4KeyCache::warm %.0f 个/秒 (%.2fx)\n",
+        setup_each, setup_warm, setup_warm / setup_each);
+    // 256 个会话轮流发送 256 字节记录，缓存容量 1024（全部命中）与 128（轮流访问下每次都被淘汰）
+    for (size_t cap : { (size_t)1024, (size_t)128 }) {
+        Sm4KeyCache cache(cap);
+        double raw = measure_gcm_cached_records(256, 256, 100000, nullptr);
+        double hit = measure_gcm_cached_records(256, 256, 100000, &cache);
+        printf("256 个会话、缓存容量 %4zu: 每次建密钥 %.0f 条/秒，经缓存 %.0f 条/秒 (%.2fx)，命中 %llu 未命中 %llu 淘汰 %llu\n",
+            cap, raw, hit, hit / raw, (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+            (unsigned long long)cache.evictions);
+    }
+
+    // 多条小记录批处理：64 条一批，计数器分组拼在一起交给多分组内核
+    const size_t pkt_lens[] = { 64, 128, 256, 512 };
+    for (size_t n : pkt_lens) {
+        int rounds = (int)((32u << 20) / (64 * n));
+        double single = measure_gcm_batch_records(key, n, 64, rounds, false);
+        double batched = measure_gcm_batch_records(key, n, 64, rounds, true);
+        printf("SM4-GCM %4zu 字节记录 x64: 逐条 %.0f 条/秒，批处理 %.0f 条/秒 (%.2fx)\n",
+            n, single, batched, batched / single);
+    }
+
+    // 单条 256MB 消息：单线程与多线程（GHASH 分段合并）
+    {
+        Sm4ThreadPool pool;
+        double serial = measure_gcm_parallel_efficiency(nullptr, 256u << 20, 2);
+        double parallel = measure_gcm_parallel_efficiency(&pool, 256u << 20, 2);
+        printf("SM4-GCM 256MB 单条消息: 单线程 %.2f MB/s，%u 线程（GHASH 分段合并）%.2f MB/s (%.2fx)\n",
+            serial, pool.size(), parallel, parallel / serial);
+    }
+
+    // 低延迟小消息：按需计算 vs 空闲时预取的密钥流
+    for (size_t n : rec_lens) {
+        Sm4KeystreamStats st;
+        double on_demand = measure_gcm_prefetch_latency(n, 100000, nullptr);
+        double prefetched = measure_gcm_prefetch_latency(n, 100000, &st);
+        printf("SM4-GCM %4zu 字节消息: 按需计算 %.0f ns/条，预取密钥流 %.0f ns/条 (%.2fx)，命中率 %.1f%%\n",
+            n, on_demand, prefetched, on_demand / prefetched, 100 * st.hit_rate());
+    }
+
+    // 分段记录原地加密：拷贝到连续缓冲区 vs 分段接口。1448 字节为 TCP 段（短于暂存批），
+    // 16KB 为存储层的页链（段内直接处理）
+    const size_t iov_cases[][2] = { { 4096, 1448 }, { 16384, 1448 }, { 65536, 1448 }, { 65536, 16384 }, { 262144, 16384 } };
+    for (const auto& c : iov_cases) {
+        size_t n = c[0], seg = c[1];
+        int count = (int)((64u << 20) / n);
+        double staged = measure_gcm_iov_records(key, iv, n, seg, count, false);
+        double direct = measure_gcm_iov_records(key, iv, n, seg, count, true);
+        printf("SM4-GCM %6zu 字节记录（%5zu 字节分段）: 拷贝到连续缓冲区 %.2f MB/s，分段接口 %.2f MB/s (%.2fx)\n",
+            n, seg, staged, direct, direct / staged);
+    }
+
+    // 输出原始加密结果验证
+    u32 rk[32];
+    sm4_key_expand(key, rk);
+    u8 ct_basic[16], ct_ttable[16];
+    sm4_encrypt_block(plain_block, ct_basic, rk);
+    sm4_encrypt_block_ttable(plain_block, ct_ttable, rk);
+    printf("\n加密结果验证 (16 字节块):\n");
+    printf("基础: "); for (int i = 0; i < 16; i++) printf("%02x", ct_basic[i]); printf("\n");
+    printf("T表: "); for (int i = 0; i < 16; i++) printf("%02x", ct_ttable[i]); printf("\n");
+    printf("SM4-GCM 标准测试向量 (RFC 8998，各 SM4 内核): %s\n", sm4_gcm_known_answer_test() ? "通过" : "失败");
+    printf("SM4-GCM 篡改检测（拒绝且不输出明文）: %s\n", sm4_gcm_tamper_test() ? "通过" : "失败");
+    printf("SM4-GCM 批处理与逐条结果一致: %s\n", sm4_gcm_batch_test() ? "通过" : "失败");
+    printf("SM4-GCM 分段输入输出与连续接口一致: %s\n", sm4_gcm_iov_test() ? "通过" : "失败");
+    printf("SM4-GCM 多线程（GHASH 分段合并）与单线程一致: %s\n", sm4_gcm_parallel_test() ? "通过" : "失败");
+    printf("SM4-GCM 密钥流预取与按需计算一致: %s\n", sm4_gcm_keystream_test() ? "通过" : "失败");
+    printf("SM4-GCM 密钥缓存成组装入与逐个构造一致、erase 不移动其余项: %s\n", sm4_gcm_key_cache_test() ? "通过" : "失败");
+
+    return 0;
+}
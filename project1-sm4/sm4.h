@@ -0,0 +1,1884 @@
+// SM4 核心实现与各 SIMD 内核，供 SM4-源.cpp、sm4-GCM.cpp 与 sm4_file.cpp 共用。头文件中的函数与全局表都是 inline，
+// 同一程序的多个翻译单元可以同时包含本目录的各个头文件。
+// 所有内核都按函数单独指定目标指令集编译，运行时由 SM4_DISPATCH 根据 CPUID 选择，
+// 因此不加 -mavx2 等选项编译出的程序在新 CPU 上同样能用到快速路径。
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+using u8 = uint8_t;
+using u32 = uint32_t;
+using u64 = uint64_t;
+
+// 按函数指定目标指令集（GCC/Clang），MSVC 不需要编译选项即可使用内建函数
+#if defined(__GNUC__)
+#define SM4_TARGET(isa) __attribute__((target(isa)))
+#define SM4_TARGET_FLATTEN(isa) __attribute__((target(isa), flatten))
+#define SM4_FORCEINLINE inline __attribute__((always_inline))
+#else
+#define SM4_TARGET(isa)
+#define SM4_TARGET_FLATTEN(isa)
+#define SM4_FORCEINLINE __forceinline
+#endif
+
+// 标量交错实现不让 GCC 自动向量化：-O2 起 SLP 向量化会把几个分组的异或打包成向量，
+// 查表下标再逐个提取出来，反而比逐块还慢
+#if defined(__GNUC__) && !defined(__clang__)
+#define SM4_NO_VECTORIZE __attribute__((optimize("no-tree-vectorize")))
+#else
+#define SM4_NO_VECTORIZE
+#endif
+
+// CPU 特性探测：CPUID 只查询一次，同时用 XGETBV 确认操作系统保存了 YMM/ZMM 状态
+enum : u32 {
+    SM4_CPU_SSSE3 = 1u << 0,
+    SM4_CPU_SSE41 = 1u << 1,
+    SM4_CPU_AESNI = 1u << 2,
+    SM4_CPU_PCLMUL = 1u << 3,
+    SM4_CPU_AVX2 = 1u << 4,
+    SM4_CPU_AVX512F = 1u << 5,
+    SM4_CPU_AVX512BW = 1u << 6,
+    SM4_CPU_GFNI = 1u << 7,
+    SM4_CPU_VPCLMUL = 1u << 8,
+};
+
+static void sm4_cpuid(u32 leaf, u32 sub, u32 r[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)r, (int)leaf, (int)sub);
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+static u64 sm4_xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    u32 lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64)hi << 32) | lo;
+#endif
+}
+
+static u32 sm4_cpu_probe() {
+    u32 r[4], f = 0;
+    sm4_cpuid(0, 0, r);
+    u32 max_leaf = r[0];
+    sm4_cpuid(1, 0, r);
+    if (r[2] & (1u << 9)) f |= SM4_CPU_SSSE3;
+    if (r[2] & (1u << 19)) f |= SM4_CPU_SSE41;
+    if (r[2] & (1u << 25)) f |= SM4_CPU_AESNI;
+    if (r[2] & (1u << 1)) f |= SM4_CPU_PCLMUL;
+    bool osxsave = (r[2] & (1u << 27)) != 0;
+    u64 xcr0 = osxsave ? sm4_xgetbv0() : 0;
+    bool ymm = (xcr0 & 0x06) == 0x06;
+    bool zmm = (xcr0 & 0xE6) == 0xE6;
+    if (max_leaf >= 7) {
+        sm4_cpuid(7, 0, r);
+        if (ymm && (r[1] & (1u << 5))) f |= SM4_CPU_AVX2;
+        if (zmm && (r[1] & (1u << 16))) f |= SM4_CPU_AVX512F;
+        if (zmm && (r[1] & (1u << 30))) f |= SM4_CPU_AVX512BW;
+        if (r[2] & (1u << 8)) f |= SM4_CPU_GFNI;
+        if (ymm && (r[2] & (1u << 10))) f |= SM4_CPU_VPCLMUL;
+    }
+    return f;
+}
+
+static inline u32 sm4_cpu_features() {
+    static const u32 features = sm4_cpu_probe();
+    return features;
+}
+
+// SM4基本常量与S盒
+static const u8 SM4_SBOX[256] = {
+    0xd6,0x90,0xe9,0xfe,0xcc,0xe1,0x3d,0xb7,0x16,0xb6,0x14,0xc2,0x28,0xfb,0x2c,0x05,
+    0x2b,0x67,0x9a,0x76,0x2a,0xbe,0x04,0xc3,0xaa,0x44,0x13,0x26,0x49,0x86,0x06,0x99,
+    0x9c,0x42,0x50,0xf4,0x91,0xef,0x98,0x7a,0x33,0x54,0x0b,0x43,0xed,0xcf,0xac,0x62,
+    0xe4,0xb3,0x1c,0xa9,0xc9,0x08,0xe8,0x95,0x80,0xdf,0x94,0xfa,0x75,0x8f,0x3f,0xa6,
+    0x47,0x07,0xa7,0xfc,0xf3,0x73,0x17,0xba,0x83,0x59,0x3c,0x19,0xe6,0x85,0x4f,0xa8,
+    0x68,0x6b,0x81,0xb2,0x71,0x64,0xda,0x8b,0xf8,0xeb,0x0f,0x4b,0x70,0x56,0x9d,0x35,
+    0x1e,0x24,0x0e,0x5e,0x63,0x58,0xd1,0xa2,0x25,0x22,0x7c,0x3b,0x01,0x21,0x78,0x87,
+    0xd4,0x00,0x46,0x57,0x9f,0xd3,0x27,0x52,0x4c,0x36,0x02,0xe7,0xa0,0xc4,0xc8,0x9e,
+    0xea,0xbf,0x8a,0xd2,0x40,0xc7,0x38,0xb5,0xa3,0xf7,0xf2,0xce,0xf9,0x61,0x15,0xa1,
+    0xe0,0xae,0x5d,0xa4,0x9b,0x34,0x1a,0x55,0xad,0x93,0x32,0x30,0xf5,0x8c,0xb1,0xe3,
+    0x1d,0xf6,0xe2,0x2e,0x82,0x66,0xca,0x60,0xc0,0x29,0x23,0xab,0x0d,0x53,0x4e,0x6f,
+    0xd5,0xdb,0x37,0x45,0xde,0xfd,0x8e,0x2f,0x03,0xff,0x6a,0x72,0x6d,0x6c,0x5b,0x51,
+    0x8d,0x1b,0xaf,0x92,0xbb,0xdd,0xbc,0x7f,0x11,0xd9,0x5c,0x41,0x1f,0x10,0x5a,0xd8,
+    0x0a,0xc1,0x31,0x88,0xa5,0xcd,0x7b,0xbd,0x2d,0x74,0xd0,0x12,0xb8,0xe5,0xb4,0xb0,
+    0x89,0x69,0x97,0x4a,0x0c,0x96,0x77,0x7e,0x65,0xb9,0xf1,0x09,0xc5,0x6e,0xc6,0x84,
+    0x18,0xf0,0x7d,0xec,0x3a,0xdc,0x4d,0x20,0x79,0xee,0x5f,0x3e,0xd7,0xcb,0x39,0x48
+};
+
+static inline u32 rotl32(u32 x, int r) { return (x << r) | (x >> (32 - r)); }
+static inline u32 L_transform(u32 b) {
+    return b ^ rotl32(b, 2) ^ rotl32(b, 10) ^ rotl32(b, 18) ^ rotl32(b, 24);
+}
+static inline u32 tau(u32 a) {
+    u32 y = 0;
+    y |= (u32)SM4_SBOX[(a >> 24) & 0xFF] << 24;
+    y |= (u32)SM4_SBOX[(a >> 16) & 0xFF] << 16;
+    y |= (u32)SM4_SBOX[(a >> 8) & 0xFF] << 8;
+    y |= (u32)SM4_SBOX[(a) & 0xFF];
+    return y;
+}
+static inline u32 sm4_T(u32 x) {
+    return L_transform(tau(x));
+}
+
+// GF(2^8) 乘法，poly 为模多项式（含 x^8 项）
+static inline u8 gf256_mul(u8 a, u8 b, u32 poly) {
+    u32 r = 0, x = a;
+    for (int i = 0; i < 8; ++i) {
+        if ((b >> i) & 1) r ^= x;
+        x <<= 1;
+        if (x & 0x100) x ^= poly;
+    }
+    return (u8)r;
+}
+
+static inline u8 rotl8(u8 x, int r) { return (u8)((x << r) | (x >> (8 - r))); }
+
+// SM4 S 盒的仿射部分（线性）：S(x) = A·I(A·x + 0xD3) + 0xD3，A·x = x ^ (x<<<1) ^ (x<<<3) ^ (x<<<6) ^ (x<<<7)
+static inline u8 sm4_sbox_affine(u8 x) {
+    return x ^ rotl8(x, 1) ^ rotl8(x, 3) ^ rotl8(x, 6) ^ rotl8(x, 7);
+}
+
+static const u32 FK[4] = { 0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc };
+static const u32 CK[32] = {
+    0x00070e15,0x1c232a31,0x383f464d,0x545b6269,0x70777e85,0x8c939aa1,0xa8afb6bd,0xc4cbd2d9,
+    0xe0e7eef5,0xfc030a11,0x181f262d,0x343b4249,0x50575e65,0x6c737a81,0x888f969d,0xa4abb2b9,
+    0xc0c7ced5,0xdce3eaf1,0xf8ff060d,0x141b2229,0x30373e45,0x4c535a61,0x686f767d,0x848b9299,
+    0xa0a7aeb5,0xbcc3cad1,0xd8dfe6ed,0xf4fb0209,0x10171e25,0x2c333a41,0x484f565d,0x646b7279
+};
+
+inline void sm4_key_expand(const u8 key[16], u32 rk[32]) {
+    u32 MK[4] = { 0 };
+    for (int i = 0; i < 4; ++i) {
+        MK[i] = (u32(key[4 * i]) << 24) | (u32(key[4 * i + 1]) << 16) |
+            (u32(key[4 * i + 2]) << 8) | u32(key[4 * i + 3]);
+    }
+    u32 K[4] = { 0 };
+    for (int i = 0; i < 4; ++i) K[i] = MK[i] ^ FK[i];
+    for (int i = 0; i < 32; ++i) {
+        u32 tmp = K[1] ^ K[2] ^ K[3] ^ CK[i];
+        u32 t = tau(tmp);
+        u32 rk_i = K[0] ^ (t ^ rotl32(t, 13) ^ rotl32(t, 23));
+        rk[i] = rk_i;
+        K[0] = K[1]; K[1] = K[2]; K[2] = K[3]; K[3] = rk_i;
+    }
+}
+
+// 解密轮密钥：SM4 解密与加密结构相同，只是轮密钥逆序使用，
+// 因此所有加密内核传入 rk_dec 即完成解密
+inline void sm4_key_expand_dec(const u8 key[16], u32 rk_dec[32]) {
+    u32 rk[32];
+    sm4_key_expand(key, rk);
+    for (int i = 0; i < 32; ++i) rk_dec[i] = rk[31 - i];
+}
+
+// 基础实现
+inline void sm4_encrypt_block(const u8 in[16], u8 out[16], const u32 rk[32]) {
+   
+    u32 X[4] = { 0 };
+    for (int i = 0; i < 4; ++i) {
+        X[i] = (u32(in[4 * i]) << 24) | (u32(in[4 * i + 1]) << 16) |
+            (u32(in[4 * i + 2]) << 8) | u32(in[4 * i + 3]);
+    }
+    for (int i = 0; i < 32; ++i) {
+        u32 tmp = X[1] ^ X[2] ^ X[3] ^ rk[i];
+        u32 t = sm4_T(tmp);
+        u32 newX = X[0] ^ t;
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = newX;
+    }
+    for (int i = 0; i < 4; ++i) {
+        u32 outw = X[3 - i];
+        out[4 * i + 0] = (u8)(outw >> 24);
+        out[4 * i + 1] = (u8)(outw >> 16);
+        out[4 * i + 2] = (u8)(outw >> 8);
+        out[4 * i + 3] = (u8)(outw);
+    }
+}
+
+// T表优化实现
+using ttable_t = std::array<u32, 256>;
+struct SM4_TTABLE {
+    ttable_t T0, T1, T2, T3;
+    void init_from_sbox() {
+        for (int b = 0; b < 256; ++b) {
+            u32 sb = (u32)SM4_SBOX[b];
+            u32 w0 = L_transform((u32)sb << 24);
+            u32 w1 = L_transform((u32)sb << 16);
+            u32 w2 = L_transform((u32)sb << 8);
+            u32 w3 = L_transform((u32)sb);
+            T0[b] = w0;
+            T1[b] = w1;
+            T2[b] = w2;
+            T3[b] = w3;
+        }
+    }
+};
+inline SM4_TTABLE TTABLE;
+
+inline void sm4_encrypt_block_ttable(const u8 in[16], u8 out[16], const u32 rk[32]) {
+    u32 X[4] = { 0 };
+    for (int i = 0; i < 4; ++i) X[i] = (u32(in[4 * i]) << 24) | (u32(in[4 * i + 1]) << 16) |
+        (u32(in[4 * i + 2]) << 8) | u32(in[4 * i + 3]);
+    for (int r = 0; r < 32; ++r) {
+        u32 a = X[1] ^ X[2] ^ X[3] ^ rk[r];
+        u8 b0 = (a >> 24) & 0xFF;
+        u8 b1 = (a >> 16) & 0xFF;
+        u8 b2 = (a >> 8) & 0xFF;
+        u8 b3 = a & 0xFF;
+        u32 t = TTABLE.T0[b0] ^ TTABLE.T1[b1] ^ TTABLE.T2[b2] ^ TTABLE.T3[b3];
+        u32 newX = X[0] ^ t;
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = newX;
+    }
+    for (int i = 0; i < 4; ++i) {
+        u32 outw = X[3 - i];
+        out[4 * i + 0] = (u8)(outw >> 24);
+        out[4 * i + 1] = (u8)(outw >> 16);
+        out[4 * i + 2] = (u8)(outw >> 8);
+        out[4 * i + 3] = (u8)(outw);
+    }
+}
+
+// 多分组交错的 T 表实现：单个分组的 32 轮是一条串行依赖链，每轮 4 次查表要等上一轮的结果。
+// N 个互不相关的分组在同一轮内交错计算，各链的查表与异或可以同时发射，没有 SIMD 时也能用满载入端口。
+// 状态按字存放：X[i][b] 为第 b 个分组的第 i 个字
+template<int N>
+static SM4_FORCEINLINE void sm4_ttable_round(u32 X[4][N], int i0, int i1, int i2, int i3, u32 k) {
+    for (int b = 0; b < N; ++b) {
+        u32 a = X[i1][b] ^ X[i2][b] ^ X[i3][b] ^ k;
+        X[i0][b] ^= TTABLE.T0[a >> 24] ^ TTABLE.T1[(a >> 16) & 0xFF] ^ TTABLE.T2[(a >> 8) & 0xFF] ^ TTABLE.T3[a & 0xFF];
+    }
+}
+
+template<int N>
+SM4_NO_VECTORIZE void sm4_encrypt_nblocks_ttable_t(const u8* in, u8* out, const u32 rk[32]) {
+    u32 X[4][N];
+    for (int b = 0; b < N; ++b)
+        for (int i = 0; i < 4; ++i) {
+            const u8* p = in + 16 * b + 4 * i;
+            X[i][b] = (u32(p[0]) << 24) | (u32(p[1]) << 16) | (u32(p[2]) << 8) | u32(p[3]);
+        }
+    // 每 4 轮新字依次写入 X[0..3]，不必移动状态
+    for (int r = 0; r < 32; r += 4) {
+        sm4_ttable_round<N>(X, 0, 1, 2, 3, rk[r]);
+        sm4_ttable_round<N>(X, 1, 2, 3, 0, rk[r + 1]);
+        sm4_ttable_round<N>(X, 2, 3, 0, 1, rk[r + 2]);
+        sm4_ttable_round<N>(X, 3, 0, 1, 2, rk[r + 3]);
+    }
+    for (int b = 0; b < N; ++b)
+        for (int i = 0; i < 4; ++i) {
+            u32 w = X[3 - i][b];
+            u8* p = out + 16 * b + 4 * i;
+            p[0] = (u8)(w >> 24); p[1] = (u8)(w >> 16); p[2] = (u8)(w >> 8); p[3] = (u8)w;
+        }
+}
+
+inline void sm4_encrypt_4blocks_ttable(const u8* in, u8* out, const u32 rk[32]) {
+    sm4_encrypt_nblocks_ttable_t<4>(in, out, rk);
+}
+
+// 任意分组数：每 4 块交错处理，尾部逐块
+inline void sm4_encrypt_blocks_ttable(const u8* in, u8* out, size_t nblocks, const u32 rk[32]) {
+    for (; nblocks >= 4; nblocks -= 4, in += 64, out += 64) sm4_encrypt_4blocks_ttable(in, out, rk);
+    for (; nblocks; --nblocks, in += 16, out += 16) sm4_encrypt_block_ttable(in, out, rk);
+}
+
+// 复合域 S 盒表：GF(2^4) 模 z^4 + z + 1，GF((2^4)^2) 模 y^2 + y + λ（λ = z^3 + 1），
+// 与比特切片实现使用同一个塔域。所有表都只有 16 项，供 vpshufb 在寄存器内查表
+static inline u8 gf16_mul(u8 a, u8 b) {
+    u8 r = 0;
+    for (int i = 0; i < 4; ++i) {
+        if ((b >> i) & 1) r ^= a;
+        a <<= 1;
+        if (a & 0x10) a ^= 0x13;
+    }
+    return r;
+}
+
+// 元素 (a1 << 4) | a0 表示 a1·y + a0
+static inline u8 gf16x2_mul(u8 a, u8 b) {
+    u8 a1 = a >> 4, a0 = a & 15, b1 = b >> 4, b0 = b & 15;
+    u8 p = gf16_mul(a1, b1);
+    return (u8)(((p ^ gf16_mul(a1, b0) ^ gf16_mul(a0, b1)) << 4) | (gf16_mul(p, 9) ^ gf16_mul(a0, b0)));
+}
+
+struct SM4_NIBBLE_TABLE {
+    alignas(16) u8 in_lo[16], in_hi[16];    // 输入仿射 + 同构，结果的高/低半字节为 a1/a0
+    alignas(16) u8 sq_lam[16], sq[16];      // λ·a^2、a^2
+    alignas(16) u8 log[16], log_inv[16];    // log(a)、log(a^-1)，0 记为 0xF0
+    alignas(16) u8 exp[16];
+    alignas(16) u8 out_lo[16], out_hi[16];  // 逆同构 + 输出仿射
+
+    // 按 SIMD 路径同样的步骤（含 0xF0 哨兵的对数运算）计算一个 S 盒
+    u8 mul_log(u8 la, u8 lb) const {
+        u32 s = (u32)la + lb;
+        u8 s8 = (u8)(s > 0xFF ? 0xFF : s);
+        u8 m = (u8)(s8 - 15);
+        if (m < s8) s8 = m;
+        return (s8 & 0x80) ? 0 : exp[s8 & 15];
+    }
+    u8 sbox(u8 x) const {
+        u8 t = in_lo[x & 15] ^ in_hi[x >> 4];
+        u8 a0 = t & 15, a1 = t >> 4;
+        u8 d = sq_lam[a1] ^ sq[a0] ^ mul_log(log[a1], log[a0]);
+        u8 b1 = mul_log(log[a1], log_inv[d]);
+        u8 b0 = mul_log(log[a0 ^ a1], log_inv[d]);
+        return out_lo[b0] ^ out_hi[b1];
+    }
+
+    bool init_from_sbox() {
+        u8 e = 1;
+        log[0] = log_inv[0] = 0xF0;
+        for (int i = 0; i < 15; ++i) {
+            exp[i] = e;
+            log[e] = (u8)i;
+            e = gf16_mul(e, 2);
+        }
+        exp[15] = 1;
+        for (int n = 1; n < 16; ++n) log_inv[n] = (u8)((15 - log[n]) % 15);
+        for (int n = 0; n < 16; ++n) {
+            sq[n] = gf16_mul((u8)n, (u8)n);
+            sq_lam[n] = gf16_mul(sq[n], 9);
+        }
+        // 在塔域中找 SM4 域多项式的根 beta，同构映射把 x^i 映到 beta^i
+        u8 basis[8] = { 0 };
+        for (u32 beta = 2; beta < 256; ++beta) {
+            u8 pw[9];
+            pw[0] = 1;
+            for (int i = 1; i <= 8; ++i) pw[i] = gf16x2_mul(pw[i - 1], (u8)beta);
+            if ((pw[8] ^ pw[7] ^ pw[6] ^ pw[5] ^ pw[4] ^ pw[2] ^ pw[0]) == 0) {
+                memcpy(basis, pw, 8);
+                break;
+            }
+        }
+        u8 phi[256], phi_inv[256];
+        for (int x = 0; x < 256; ++x) {
+            u8 y = 0;
+            for (int i = 0; i < 8; ++i) if ((x >> i) & 1) y ^= basis[i];
+            phi[x] = y;
+            phi_inv[y] = (u8)x;
+        }
+        for (int n = 0; n < 16; ++n) {
+            in_lo[n] = phi[sm4_sbox_affine((u8)n) ^ 0xD3];
+            in_hi[n] = phi[sm4_sbox_affine((u8)(n << 4))];
+            out_lo[n] = sm4_sbox_affine(phi_inv[n]) ^ 0xD3;
+            out_hi[n] = sm4_sbox_affine(phi_inv[n << 4]);
+        }
+        for (int x = 0; x < 256; ++x) {
+            if (sbox((u8)x) != SM4_SBOX[x]) return false;
+        }
+        return true;
+    }
+};
+inline SM4_NIBBLE_TABLE NIBBLE_TABLE;
+
+// GFNI 仿射矩阵：S(x) = M2·Inv_aes(M1·x + c1) + 0xD3，其中 Phi 为 SM4 域到 AES 域的同构，
+// M1 = Phi·A，c1 = Phi(0xD3)，M2 = A·Phi^-1。构造只用软件运算，不要求 CPU 支持 GFNI
+struct SM4_GFNI_TABLE {
+    u64 in_mat, out_mat;  // GF2P8AFFINEQB 的 8x8 比特矩阵，第 7-i 个字节为输出第 i 位的行
+    u8 in_c;
+
+    template<typename F>
+    static u64 affine_matrix(F f) {
+        u64 m = 0;
+        for (int j = 0; j < 8; ++j) {
+            u8 col = f((u8)(1 << j));
+            for (int i = 0; i < 8; ++i)
+                if ((col >> i) & 1) m |= (u64)1 << (8 * (7 - i) + j);
+        }
+        return m;
+    }
+    static u8 affine(u64 m, u8 x) {
+        u8 y = 0;
+        for (int i = 0; i < 8; ++i) {
+            u8 row = (u8)(m >> (8 * (7 - i))) & x;
+            row ^= row >> 4; row ^= row >> 2; row ^= row >> 1;
+            y |= (u8)((row & 1) << i);
+        }
+        return y;
+    }
+
+    bool init_from_sbox() {
+        u8 basis[8] = { 0 };
+        for (u32 beta = 2; beta < 256; ++beta) {
+            u8 pw[9];
+            pw[0] = 1;
+            for (int i = 1; i <= 8; ++i) pw[i] = gf256_mul(pw[i - 1], (u8)beta, 0x11B);
+            if ((pw[8] ^ pw[7] ^ pw[6] ^ pw[5] ^ pw[4] ^ pw[2] ^ pw[0]) == 0) {
+                memcpy(basis, pw, 8);
+                break;
+            }
+        }
+        u8 phi[256], phi_inv[256], aes_inv[256] = { 0 };
+        for (int x = 0; x < 256; ++x) {
+            u8 y = 0;
+            for (int i = 0; i < 8; ++i) if ((x >> i) & 1) y ^= basis[i];
+            phi[x] = y;
+            phi_inv[y] = (u8)x;
+        }
+        for (int x = 1; x < 256; ++x)
+            for (int y = 1; y < 256; ++y)
+                if (gf256_mul((u8)x, (u8)y, 0x11B) == 1) { aes_inv[x] = (u8)y; break; }
+        in_mat = affine_matrix([&](u8 x) { return phi[sm4_sbox_affine(x)]; });
+        out_mat = affine_matrix([&](u8 x) { return sm4_sbox_affine(phi_inv[x]); });
+        in_c = phi[0xD3];
+        for (int x = 0; x < 256; ++x) {
+            u8 y = affine(in_mat, (u8)x) ^ in_c;
+            if ((u8)(affine(out_mat, aes_inv[y]) ^ 0xD3) != SM4_SBOX[x]) return false;
+        }
+        return true;
+    }
+};
+inline SM4_GFNI_TABLE GFNI_TABLE;
+
+// 多分组内核自检：与基础实现逐块比对，通过才报告吞吐量
+typedef void (*sm4_multi_fn)(const u8* in, u8* out, const u32 rk[32]);
+inline bool sm4_kernel_self_check(sm4_multi_fn kernel, int nblocks, const u32 rk[32]) {
+    std::vector<u8> in(nblocks * 16), ref(nblocks * 16), out(nblocks * 16);
+    for (int i = 0; i < nblocks * 16; ++i) in[i] = (u8)(i * 37 + 11);
+    for (int i = 0; i < nblocks; ++i) sm4_encrypt_block(&in[16 * i], &ref[16 * i], rk);
+    kernel(in.data(), out.data(), rk);
+    return ref == out;
+}
+
+// AVX2优化相关定义与实现
+// 8 个分组 -> 4 个字向量：低 128 位为分组 0~3，高 128 位为分组 4~7，
+// 每个 128 位通道内做一次 4x4 的 32 位转置，X[w] 的第 i 个通道为第 i 个分组的第 w 个字
+SM4_TARGET("avx2") static inline void sm4_avx2_load8(const u8* in, __m256i X[4]) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i b[4];
+    for (int i = 0; i < 4; ++i) {
+        __m256i v = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(in + 16 * (i + 4))),
+            _mm_loadu_si128((const __m128i*)(in + 16 * i)));
+        b[i] = _mm256_shuffle_epi8(v, bswap);
+    }
+    __m256i t0 = _mm256_unpacklo_epi32(b[0], b[1]);
+    __m256i t1 = _mm256_unpacklo_epi32(b[2], b[3]);
+    __m256i t2 = _mm256_unpackhi_epi32(b[0], b[1]);
+    __m256i t3 = _mm256_unpackhi_epi32(b[2], b[3]);
+    X[0] = _mm256_unpacklo_epi64(t0, t1);
+    X[1] = _mm256_unpackhi_epi64(t0, t1);
+    X[2] = _mm256_unpacklo_epi64(t2, t3);
+    X[3] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+// 4 个字向量 -> 8 个分组，按 X3, X2, X1, X0 的反序输出
+SM4_TARGET("avx2") static inline void sm4_avx2_store8(u8* out, const __m256i X[4]) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i t0 = _mm256_unpacklo_epi32(X[3], X[2]);
+    __m256i t1 = _mm256_unpacklo_epi32(X[1], X[0]);
+    __m256i t2 = _mm256_unpackhi_epi32(X[3], X[2]);
+    __m256i t3 = _mm256_unpackhi_epi32(X[1], X[0]);
+    __m256i b[4];
+    b[0] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t0, t1), bswap);
+    b[1] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t0, t1), bswap);
+    b[2] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t2, t3), bswap);
+    b[3] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t2, t3), bswap);
+    for (int i = 0; i < 4; ++i) {
+        _mm_storeu_si128((__m128i*)(out + 16 * i), _mm256_castsi256_si128(b[i]));
+        _mm_storeu_si128((__m128i*)(out + 16 * (i + 4)), _mm256_extracti128_si256(b[i], 1));
+    }
+}
+
+// 轮函数 T = L(τ(x)) 的两种 AVX2 策略，作为模板参数选择：
+//   Sm4GatherTTable —— vpgatherdd 直接查 SM4_TTABLE（S 盒与 L 合并在表中）；
+//   Sm4NibbleSbox   —— 复合域 GF((2^4)^2) 上求逆，所有查表都是寄存器内 16 项的 vpshufb，
+//                      不访问内存、常数时间，也不受 gather 端口吞吐限制
+struct Sm4GatherTTable {
+    SM4_TARGET("avx2") static inline __m256i T(__m256i t) {
+        const int* T0 = (const int*)TTABLE.T0.data();
+        const int* T1 = (const int*)TTABLE.T1.data();
+        const int* T2 = (const int*)TTABLE.T2.data();
+        const int* T3 = (const int*)TTABLE.T3.data();
+        const __m256i mask_ff = _mm256_set1_epi32(0xFF);
+        __m256i b0 = _mm256_srli_epi32(t, 24);
+        __m256i b1 = _mm256_and_si256(_mm256_srli_epi32(t, 16), mask_ff);
+        __m256i b2 = _mm256_and_si256(_mm256_srli_epi32(t, 8), mask_ff);
+        __m256i b3 = _mm256_and_si256(t, mask_ff);
+        return _mm256_xor_si256(
+            _mm256_xor_si256(_mm256_i32gather_epi32(T0, b0, 4), _mm256_i32gather_epi32(T1, b1, 4)),
+            _mm256_xor_si256(_mm256_i32gather_epi32(T2, b2, 4), _mm256_i32gather_epi32(T3, b3, 4)));
+    }
+};
+
+// vpshufb 形式的 GF(2^4) 乘法：输入为对数，0 的对数记为 0xF0。
+// 饱和加法后 s ∈ [0, 28] 或 s >= 0xF0；min(s, s - 15) 完成模 15，含 0 的情形保持最高位为 1，查表得 0
+SM4_TARGET("avx2") static inline __m256i gf16_mul_log_avx2(__m256i la, __m256i lb, __m256i exp) {
+    __m256i s = _mm256_adds_epu8(la, lb);
+    s = _mm256_min_epu8(s, _mm256_sub_epi8(s, _mm256_set1_epi8(15)));
+    return _mm256_shuffle_epi8(exp, s);
+}
+
+SM4_TARGET("avx2") static inline __m256i nibble_table_avx2(const u8 t[16]) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)t));
+}
+
+// 32 个 S 盒：x -> (a1, a0) -> (a1·y + a0)^-1 -> 输出仿射
+SM4_TARGET("avx2") static inline __m256i sm4_sbox_nibble_avx2(__m256i x) {
+    const __m256i m0f = _mm256_set1_epi8(0x0F);
+    const __m256i log = nibble_table_avx2(NIBBLE_TABLE.log);
+    const __m256i exp = nibble_table_avx2(NIBBLE_TABLE.exp);
+
+    __m256i t = _mm256_xor_si256(
+        _mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.in_lo), _mm256_and_si256(x, m0f)),
+        _mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.in_hi), _mm256_and_si256(_mm256_srli_epi16(x, 4), m0f)));
+    __m256i a0 = _mm256_and_si256(t, m0f);
+    __m256i a1 = _mm256_and_si256(_mm256_srli_epi16(t, 4), m0f);
+    __m256i la1 = _mm256_shuffle_epi8(log, a1);
+
+    // d = λ·a1^2 + a1·a0 + a0^2
+    __m256i d = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.sq_lam), a1),
+            _mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.sq), a0)),
+        gf16_mul_log_avx2(la1, _mm256_shuffle_epi8(log, a0), exp));
+    __m256i ldi = _mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.log_inv), d);
+
+    // (a1·y + a0)^-1 = (a1·d^-1)·y + (a0 + a1)·d^-1
+    __m256i b1 = gf16_mul_log_avx2(la1, ldi, exp);
+    __m256i b0 = gf16_mul_log_avx2(_mm256_shuffle_epi8(log, _mm256_xor_si256(a0, a1)), ldi, exp);
+    return _mm256_xor_si256(_mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.out_lo), b0),
+        _mm256_shuffle_epi8(nibble_table_avx2(NIBBLE_TABLE.out_hi), b1));
+}
+
+// L(B) = B ^ (B<<<24) ^ ((B ^ (B<<<8) ^ (B<<<16)) <<< 2)，整字节循环移位用 vpshufb
+SM4_TARGET("avx2") static inline __m256i sm4_L_avx2(__m256i b) {
+    const __m256i r8 = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    const __m256i r16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i r24 = _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+        12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+    __m256i u = _mm256_xor_si256(b, _mm256_xor_si256(_mm256_shuffle_epi8(b, r8), _mm256_shuffle_epi8(b, r16)));
+    u = _mm256_or_si256(_mm256_slli_epi32(u, 2), _mm256_srli_epi32(u, 30));
+    return _mm256_xor_si256(_mm256_xor_si256(b, _mm256_shuffle_epi8(b, r24)), u);
+}
+
+struct Sm4NibbleSbox {
+    SM4_TARGET("avx2") static inline __m256i T(__m256i t) {
+        return sm4_L_avx2(sm4_sbox_nibble_avx2(t));
+    }
+};
+
+// 一次加密8个16字节块：状态转置为 4 个字向量，轮函数由 SBox 策略决定
+template<typename SBox>
+SM4_TARGET("avx2") void sm4_encrypt_8blocks_avx2_t(const u8* in, u8* out, const u32 rk[32]) {
+    __m256i X[4];
+    sm4_avx2_load8(in, X);
+    for (int r = 0; r < 32; ++r) {
+        // tmp = X1 ^ X2 ^ X3 ^ rk[r]
+        __m256i t = _mm256_xor_si256(_mm256_xor_si256(X[(r + 1) & 3], X[(r + 2) & 3]),
+            _mm256_xor_si256(X[(r + 3) & 3], _mm256_set1_epi32((int)rk[r])));
+        X[r & 3] = _mm256_xor_si256(X[r & 3], SBox::T(t));
+    }
+    sm4_avx2_store8(out, X);
+}
+
+SM4_TARGET("avx2") inline void sm4_encrypt_8blocks_avx2(const u8* in, u8* out, const u32 rk[32]) {
+    sm4_encrypt_8blocks_avx2_t<Sm4GatherTTable>(in, out, rk);
+}
+
+SM4_TARGET("avx2") inline void sm4_encrypt_8blocks_avx2_nibble(const u8* in, u8* out, const u32 rk[32]) {
+    sm4_encrypt_8blocks_avx2_t<Sm4NibbleSbox>(in, out, rk);
+}
+
+// GFNI：32 个 S 盒只需两条指令，VGF2P8AFFINEQB 完成 M1 映射，VGF2P8AFFINEINVQB 完成 AES 域求逆与 M2
+SM4_TARGET("avx2,gfni") static inline __m256i sm4_sbox_gfni_avx2(__m256i x) {
+    __m256i y = _mm256_gf2p8affine_epi64_epi8(x, _mm256_set1_epi64x((long long)GFNI_TABLE.in_mat), 0);
+    y = _mm256_xor_si256(y, _mm256_set1_epi8((char)GFNI_TABLE.in_c));
+    return _mm256_gf2p8affineinv_epi64_epi8(y, _mm256_set1_epi64x((long long)GFNI_TABLE.out_mat), 0xD3);
+}
+
+// 目标指令集不同，不能与上面两种策略共用模板，这里单独写出轮循环
+SM4_TARGET("avx2,gfni") inline void sm4_encrypt_8blocks_avx2_gfni(const u8* in, u8* out, const u32 rk[32]) {
+    __m256i X[4];
+    sm4_avx2_load8(in, X);
+    for (int r = 0; r < 32; ++r) {
+        __m256i t = _mm256_xor_si256(_mm256_xor_si256(X[(r + 1) & 3], X[(r + 2) & 3]),
+            _mm256_xor_si256(X[(r + 3) & 3], _mm256_set1_epi32((int)rk[r])));
+        X[r & 3] = _mm256_xor_si256(X[r & 3], sm4_L_avx2(sm4_sbox_gfni_avx2(t)));
+    }
+    sm4_avx2_store8(out, X);
+}
+
+// AVX-512BW：一个 ZMM 含 4 个 128 位通道，第 g 个通道放分组 4g~4g+3，一次 64 个 S 盒
+SM4_TARGET("avx512f,avx512bw") static inline __m512i gf16_mul_log_avx512(__m512i la, __m512i lb, __m512i exp) {
+    __m512i s = _mm512_adds_epu8(la, lb);
+    s = _mm512_min_epu8(s, _mm512_sub_epi8(s, _mm512_set1_epi8(15)));
+    return _mm512_shuffle_epi8(exp, s);
+}
+
+SM4_TARGET("avx512f,avx512bw") static inline __m512i nibble_table_avx512(const u8 t[16]) {
+    return _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)t));
+}
+
+SM4_TARGET("avx512f,avx512bw") static inline __m512i sm4_sbox_nibble_avx512(__m512i x) {
+    const __m512i m0f = _mm512_set1_epi8(0x0F);
+    const __m512i log = nibble_table_avx512(NIBBLE_TABLE.log);
+    const __m512i exp = nibble_table_avx512(NIBBLE_TABLE.exp);
+
+    __m512i t = _mm512_xor_si512(
+        _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.in_lo), _mm512_and_si512(x, m0f)),
+        _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.in_hi), _mm512_and_si512(_mm512_srli_epi16(x, 4), m0f)));
+    __m512i a0 = _mm512_and_si512(t, m0f);
+    __m512i a1 = _mm512_and_si512(_mm512_srli_epi16(t, 4), m0f);
+    __m512i la1 = _mm512_shuffle_epi8(log, a1);
+    __m512i d = _mm512_ternarylogic_epi32(
+        _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.sq_lam), a1),
+        _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.sq), a0),
+        gf16_mul_log_avx512(la1, _mm512_shuffle_epi8(log, a0), exp), 0x96);
+    __m512i ldi = _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.log_inv), d);
+    __m512i b1 = gf16_mul_log_avx512(la1, ldi, exp);
+    __m512i b0 = gf16_mul_log_avx512(_mm512_shuffle_epi8(log, _mm512_xor_si512(a0, a1)), ldi, exp);
+    return _mm512_xor_si512(_mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.out_lo), b0),
+        _mm512_shuffle_epi8(nibble_table_avx512(NIBBLE_TABLE.out_hi), b1));
+}
+
+// 16 个分组 -> 4 个字向量：第 g 个 128 位通道放分组 4g~4g+3，通道内 4x4 转置
+SM4_TARGET("avx512f,avx512bw") static inline void sm4_avx512_load16(const u8* in, __m512i X[4]) {
+    const __m512i bswap = _mm512_broadcast_i32x4(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+    __m512i b[4];
+    for (int i = 0; i < 4; ++i) {
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)(in + 16 * i)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(in + 16 * (i + 4))), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(in + 16 * (i + 8))), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(in + 16 * (i + 12))), 3);
+        b[i] = _mm512_shuffle_epi8(v, bswap);
+    }
+    __m512i t0 = _mm512_unpacklo_epi32(b[0], b[1]);
+    __m512i t1 = _mm512_unpacklo_epi32(b[2], b[3]);
+    __m512i t2 = _mm512_unpackhi_epi32(b[0], b[1]);
+    __m512i t3 = _mm512_unpackhi_epi32(b[2], b[3]);
+    X[0] = _mm512_unpacklo_epi64(t0, t1);
+    X[1] = _mm512_unpackhi_epi64(t0, t1);
+    X[2] = _mm512_unpacklo_epi64(t2, t3);
+    X[3] = _mm512_unpackhi_epi64(t2, t3);
+}
+
+SM4_TARGET("avx512f,avx512bw") static inline void sm4_avx512_store16(u8* out, const __m512i X[4]) {
+    const __m512i bswap = _mm512_broadcast_i32x4(
+        _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+    __m512i t0 = _mm512_unpacklo_epi32(X[3], X[2]);
+    __m512i t1 = _mm512_unpacklo_epi32(X[1], X[0]);
+    __m512i t2 = _mm512_unpackhi_epi32(X[3], X[2]);
+    __m512i t3 = _mm512_unpackhi_epi32(X[1], X[0]);
+    __m512i b[4];
+    b[0] = _mm512_shuffle_epi8(_mm512_unpacklo_epi64(t0, t1), bswap);
+    b[1] = _mm512_shuffle_epi8(_mm512_unpackhi_epi64(t0, t1), bswap);
+    b[2] = _mm512_shuffle_epi8(_mm512_unpacklo_epi64(t2, t3), bswap);
+    b[3] = _mm512_shuffle_epi8(_mm512_unpackhi_epi64(t2, t3), bswap);
+    for (int i = 0; i < 4; ++i) {
+        _mm_storeu_si128((__m128i*)(out + 16 * i), _mm512_castsi512_si128(b[i]));
+        _mm_storeu_si128((__m128i*)(out + 16 * (i + 4)), _mm512_extracti32x4_epi32(b[i], 1));
+        _mm_storeu_si128((__m128i*)(out + 16 * (i + 8)), _mm512_extracti32x4_epi32(b[i], 2));
+        _mm_storeu_si128((__m128i*)(out + 16 * (i + 12)), _mm512_extracti32x4_epi32(b[i], 3));
+    }
+}
+
+// L 变换用 vprold 与三元逻辑指令
+SM4_TARGET("avx512f,avx512bw") static inline __m512i sm4_L_avx512(__m512i s) {
+    __m512i l = _mm512_ternarylogic_epi32(s, _mm512_rol_epi32(s, 2), _mm512_rol_epi32(s, 10), 0x96);
+    return _mm512_ternarylogic_epi32(l, _mm512_rol_epi32(s, 18), _mm512_rol_epi32(s, 24), 0x96);
+}
+
+// 一次加密16个16字节块
+SM4_TARGET("avx512f,avx512bw") inline void sm4_encrypt_16blocks_avx512_nibble(const u8* in, u8* out, const u32 rk[32]) {
+    __m512i X[4];
+    sm4_avx512_load16(in, X);
+    for (int r = 0; r < 32; ++r) {
+        __m512i t = _mm512_ternarylogic_epi32(X[(r + 1) & 3], X[(r + 2) & 3], X[(r + 3) & 3], 0x96);
+        t = _mm512_xor_si512(t, _mm512_set1_epi32((int)rk[r]));
+        X[r & 3] = _mm512_xor_si512(X[r & 3], sm4_L_avx512(sm4_sbox_nibble_avx512(t)));
+    }
+    sm4_avx512_store16(out, X);
+}
+
+SM4_TARGET("avx512f,avx512bw,gfni") static inline __m512i sm4_sbox_gfni_avx512(__m512i x) {
+    __m512i y = _mm512_gf2p8affine_epi64_epi8(x, _mm512_set1_epi64((long long)GFNI_TABLE.in_mat), 0);
+    y = _mm512_xor_si512(y, _mm512_set1_epi8((char)GFNI_TABLE.in_c));
+    return _mm512_gf2p8affineinv_epi64_epi8(y, _mm512_set1_epi64((long long)GFNI_TABLE.out_mat), 0xD3);
+}
+
+SM4_TARGET("avx512f,avx512bw,gfni") inline void sm4_encrypt_16blocks_avx512_gfni(const u8* in, u8* out, const u32 rk[32]) {
+    __m512i X[4];
+    sm4_avx512_load16(in, X);
+    for (int r = 0; r < 32; ++r) {
+        __m512i t = _mm512_ternarylogic_epi32(X[(r + 1) & 3], X[(r + 2) & 3], X[(r + 3) & 3], 0x96);
+        t = _mm512_xor_si512(t, _mm512_set1_epi32((int)rk[r]));
+        X[r & 3] = _mm512_xor_si512(X[r & 3], sm4_L_avx512(sm4_sbox_gfni_avx512(t)));
+    }
+    sm4_avx512_store16(out, X);
+}
+
+// AES-NI优化相关定义与实现
+// SM4 与 AES 的 S 盒都是 GF(2^8) 上的求逆加仿射变换，两个域同构，因此
+//   S_sm4(x) = F2(SubBytes_aes(F1(x)))
+// 其中 F1 为 SM4 输入仿射后接同构映射，F2 为 AES 仿射之逆、逆同构与 SM4 输出仿射的复合，二者都是仿射变换，
+// 用高低半字节各一次 _mm_shuffle_epi8 查 16 项表完成；SubBytes 由 AESENCLAST（轮密钥为 0）完成。
+struct SM4_AESNI_TABLE {
+    alignas(16) u8 in_lo[16], in_hi[16];    // F1 的低/高半字节表（常数并入 in_lo）
+    alignas(16) u8 out_lo[16], out_hi[16];  // F2 的低/高半字节表（常数并入 out_lo）
+
+    // 构造 F1/F2 并与 SM4_SBOX 逐项比对，失败返回 false；只能在支持 AES-NI 的 CPU 上调用
+    SM4_TARGET("aes") bool init_from_sbox() {
+        // 在 AES 域 GF(2^8)/(x^8+x^4+x^3+x+1) 中找 SM4 域多项式 x^8+x^7+x^6+x^5+x^4+x^2+1 的根 beta，
+        // 同构映射 Phi 把 SM4 域的 x^i 映到 beta^i
+        u8 basis[8] = { 0 };
+        for (u32 beta = 2; beta < 256; ++beta) {
+            u8 pw[9];
+            pw[0] = 1;
+            for (int i = 1; i <= 8; ++i) pw[i] = gf256_mul(pw[i - 1], (u8)beta, 0x11B);
+            if ((pw[8] ^ pw[7] ^ pw[6] ^ pw[5] ^ pw[4] ^ pw[2] ^ pw[0]) == 0) {
+                memcpy(basis, pw, 8);
+                break;
+            }
+        }
+        auto phi = [&](u8 x) {
+            u8 y = 0;
+            for (int i = 0; i < 8; ++i) if ((x >> i) & 1) y ^= basis[i];
+            return y;
+        };
+        auto f1 = [&](u8 x) { return phi(sm4_sbox_affine(x) ^ 0xD3); };
+        // 用 AESENCLAST 取得 AES S 盒，由 S_sm4(x) = F2(SubBytes(F1(x))) 反推 F2
+        u8 f2[256];
+        for (int x = 0; x < 256; ++x) {
+            __m128i v = _mm_aesenclast_si128(_mm_set1_epi8((char)f1((u8)x)), _mm_setzero_si128());
+            f2[(u8)_mm_cvtsi128_si32(v)] = SM4_SBOX[x];
+        }
+        for (int n = 0; n < 16; ++n) {
+            in_lo[n] = f1((u8)n);
+            in_hi[n] = f1((u8)(n << 4)) ^ f1(0);
+            out_lo[n] = f2[n];
+            out_hi[n] = f2[n << 4] ^ f2[0];
+        }
+        for (int x = 0; x < 256; ++x) {
+            u8 y = in_lo[x & 15] ^ in_hi[x >> 4];
+            __m128i v = _mm_aesenclast_si128(_mm_set1_epi8((char)y), _mm_setzero_si128());
+            u8 z = (u8)_mm_cvtsi128_si32(v);
+            if ((u8)(out_lo[z & 15] ^ out_hi[z >> 4]) != SM4_SBOX[x]) return false;
+        }
+        return true;
+    }
+};
+inline SM4_AESNI_TABLE AESNI_TABLE;
+
+// 4 个分组 -> 4 个字向量（X[w] 的第 i 个 32 位通道为第 i 个分组的第 w 个字）
+SM4_TARGET("aes,ssse3") static inline void sm4_sse_load4(const u8* in, __m128i X[4]) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m128i b0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 0)), bswap);
+    __m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)), bswap);
+    __m128i b2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)), bswap);
+    __m128i b3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)), bswap);
+    __m128i t0 = _mm_unpacklo_epi32(b0, b1);
+    __m128i t1 = _mm_unpacklo_epi32(b2, b3);
+    __m128i t2 = _mm_unpackhi_epi32(b0, b1);
+    __m128i t3 = _mm_unpackhi_epi32(b2, b3);
+    X[0] = _mm_unpacklo_epi64(t0, t1);
+    X[1] = _mm_unpackhi_epi64(t0, t1);
+    X[2] = _mm_unpacklo_epi64(t2, t3);
+    X[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// 4 个字向量 -> 4 个分组，按 X3, X2, X1, X0 的反序输出
+SM4_TARGET("aes,ssse3") static inline void sm4_sse_store4(u8* out, const __m128i X[4]) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m128i t0 = _mm_unpacklo_epi32(X[3], X[2]);
+    __m128i t1 = _mm_unpacklo_epi32(X[1], X[0]);
+    __m128i t2 = _mm_unpackhi_epi32(X[3], X[2]);
+    __m128i t3 = _mm_unpackhi_epi32(X[1], X[0]);
+    _mm_storeu_si128((__m128i*)(out + 0), _mm_shuffle_epi8(_mm_unpacklo_epi64(t0, t1), bswap));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_shuffle_epi8(_mm_unpackhi_epi64(t0, t1), bswap));
+    _mm_storeu_si128((__m128i*)(out + 32), _mm_shuffle_epi8(_mm_unpacklo_epi64(t2, t3), bswap));
+    _mm_storeu_si128((__m128i*)(out + 48), _mm_shuffle_epi8(_mm_unpackhi_epi64(t2, t3), bswap));
+}
+
+// 16 个 S 盒：F1 -> AESENCLAST -> F2
+SM4_TARGET("aes,ssse3") static inline __m128i sm4_sbox_aesni(__m128i x) {
+    const __m128i mask0f = _mm_set1_epi8(0x0F);
+    // AESENCLAST 会做一次 ShiftRows，这里先做一次逆行移位抵消
+    const __m128i inv_shift_rows = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+    const __m128i in_lo = _mm_load_si128((const __m128i*)AESNI_TABLE.in_lo);
+    const __m128i in_hi = _mm_load_si128((const __m128i*)AESNI_TABLE.in_hi);
+    const __m128i out_lo = _mm_load_si128((const __m128i*)AESNI_TABLE.out_lo);
+    const __m128i out_hi = _mm_load_si128((const __m128i*)AESNI_TABLE.out_hi);
+
+    __m128i y = _mm_xor_si128(_mm_shuffle_epi8(in_lo, _mm_and_si128(x, mask0f)),
+        _mm_shuffle_epi8(in_hi, _mm_and_si128(_mm_srli_epi16(x, 4), mask0f)));
+    y = _mm_shuffle_epi8(y, inv_shift_rows);
+    y = _mm_aesenclast_si128(y, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_shuffle_epi8(out_lo, _mm_and_si128(y, mask0f)),
+        _mm_shuffle_epi8(out_hi, _mm_and_si128(_mm_srli_epi16(y, 4), mask0f)));
+}
+
+// L(B) = B ^ (B<<<24) ^ ((B ^ (B<<<8) ^ (B<<<16)) <<< 2)，整字节循环移位用 _mm_shuffle_epi8
+SM4_TARGET("aes,ssse3") static inline __m128i sm4_L_sse(__m128i b) {
+    const __m128i r8 = _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    const __m128i r16 = _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m128i r24 = _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+    __m128i u = _mm_xor_si128(b, _mm_xor_si128(_mm_shuffle_epi8(b, r8), _mm_shuffle_epi8(b, r16)));
+    u = _mm_or_si128(_mm_slli_epi32(u, 2), _mm_srli_epi32(u, 30));
+    return _mm_xor_si128(_mm_xor_si128(b, _mm_shuffle_epi8(b, r24)), u);
+}
+
+// 一次加密 16 个分组：4 组 x 4 块，每组状态转置在 4 个 XMM 中，4 组交错执行以掩盖 AESENCLAST 延迟
+SM4_TARGET("aes,ssse3") inline void sm4_encrypt_16blocks_aesni(const u8* in, u8* out, const u32 rk[32]) {
+    __m128i X[4][4];
+    for (int g = 0; g < 4; ++g) sm4_sse_load4(in + 64 * g, X[g]);
+    for (int r = 0; r < 32; ++r) {
+        __m128i k = _mm_set1_epi32((int)rk[r]);
+        for (int g = 0; g < 4; ++g) {
+            __m128i* x = X[g];
+            __m128i t = _mm_xor_si128(_mm_xor_si128(x[(r + 1) & 3], x[(r + 2) & 3]),
+                _mm_xor_si128(x[(r + 3) & 3], k));
+            x[r & 3] = _mm_xor_si128(x[r & 3], sm4_L_sse(sm4_sbox_aesni(t)));
+        }
+    }
+    for (int g = 0; g < 4; ++g) sm4_sse_store4(out + 64 * g, X[g]);
+}
+
+// 常数时间的单分组实现：CBC/CFB 加密、OFB、XTS 的末块与 tweak、CMAC 只能逐块调用，
+// 选中常数时间内核时单分组也不能退回 T 表。每轮只有一个字进 S 盒，放在 XMM 低 32 位用
+// vpshufb 复合域或 GFNI 计算，L 仍是标量循环移位
+SM4_TARGET("ssse3") static inline __m128i gf16_mul_log_sse(__m128i la, __m128i lb, __m128i exp) {
+    __m128i s = _mm_adds_epu8(la, lb);
+    s = _mm_min_epu8(s, _mm_sub_epi8(s, _mm_set1_epi8(15)));
+    return _mm_shuffle_epi8(exp, s);
+}
+
+// 与 sm4_sbox_nibble_avx2 相同的步骤，16 个 S 盒
+SM4_TARGET("ssse3") static inline __m128i sm4_sbox_nibble_sse(__m128i x) {
+    const __m128i m0f = _mm_set1_epi8(0x0F);
+    const __m128i log = _mm_load_si128((const __m128i*)NIBBLE_TABLE.log);
+    const __m128i exp = _mm_load_si128((const __m128i*)NIBBLE_TABLE.exp);
+
+    __m128i t = _mm_xor_si128(
+        _mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.in_lo), _mm_and_si128(x, m0f)),
+        _mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.in_hi), _mm_and_si128(_mm_srli_epi16(x, 4), m0f)));
+    __m128i a0 = _mm_and_si128(t, m0f);
+    __m128i a1 = _mm_and_si128(_mm_srli_epi16(t, 4), m0f);
+    __m128i la1 = _mm_shuffle_epi8(log, a1);
+    __m128i d = _mm_xor_si128(
+        _mm_xor_si128(_mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.sq_lam), a1),
+            _mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.sq), a0)),
+        gf16_mul_log_sse(la1, _mm_shuffle_epi8(log, a0), exp));
+    __m128i ldi = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.log_inv), d);
+    __m128i b1 = gf16_mul_log_sse(la1, ldi, exp);
+    __m128i b0 = gf16_mul_log_sse(_mm_shuffle_epi8(log, _mm_xor_si128(a0, a1)), ldi, exp);
+    return _mm_xor_si128(_mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.out_lo), b0),
+        _mm_shuffle_epi8(_mm_load_si128((const __m128i*)NIBBLE_TABLE.out_hi), b1));
+}
+
+SM4_TARGET("gfni") static inline __m128i sm4_sbox_gfni_sse(__m128i x) {
+    __m128i y = _mm_gf2p8affine_epi64_epi8(x, _mm_set1_epi64x((long long)GFNI_TABLE.in_mat), 0);
+    y = _mm_xor_si128(y, _mm_set1_epi8((char)GFNI_TABLE.in_c));
+    return _mm_gf2p8affineinv_epi64_epi8(y, _mm_set1_epi64x((long long)GFNI_TABLE.out_mat), 0xD3);
+}
+
+static inline void sm4_load_block(const u8 in[16], u32 X[4]) {
+    for (int i = 0; i < 4; ++i) X[i] = (u32(in[4 * i]) << 24) | (u32(in[4 * i + 1]) << 16) |
+        (u32(in[4 * i + 2]) << 8) | u32(in[4 * i + 3]);
+}
+
+static inline void sm4_store_block(const u32 X[4], u8 out[16]) {
+    for (int i = 0; i < 4; ++i) {
+        u32 w = X[3 - i];
+        out[4 * i + 0] = (u8)(w >> 24);
+        out[4 * i + 1] = (u8)(w >> 16);
+        out[4 * i + 2] = (u8)(w >> 8);
+        out[4 * i + 3] = (u8)w;
+    }
+}
+
+SM4_TARGET("ssse3") inline void sm4_encrypt_block_ssse3(const u8 in[16], u8 out[16], const u32 rk[32]) {
+    u32 X[4];
+    sm4_load_block(in, X);
+    for (int r = 0; r < 32; ++r) {
+        u32 a = X[(r + 1) & 3] ^ X[(r + 2) & 3] ^ X[(r + 3) & 3] ^ rk[r];
+        X[r & 3] ^= L_transform((u32)_mm_cvtsi128_si32(sm4_sbox_nibble_sse(_mm_cvtsi32_si128((int)a))));
+    }
+    sm4_store_block(X, out);
+}
+
+SM4_TARGET("gfni") inline void sm4_encrypt_block_gfni(const u8 in[16], u8 out[16], const u32 rk[32]) {
+    u32 X[4];
+    sm4_load_block(in, X);
+    for (int r = 0; r < 32; ++r) {
+        u32 a = X[(r + 1) & 3] ^ X[(r + 2) & 3] ^ X[(r + 3) & 3] ^ rk[r];
+        X[r & 3] ^= L_transform((u32)_mm_cvtsi128_si32(sm4_sbox_gfni_sse(_mm_cvtsi32_si128((int)a))));
+    }
+    sm4_store_block(X, out);
+}
+
+// 比特切片（bitslice）实现
+// 将 64 个分组转置为 128 个比特平面（每个平面一个 u64，第 j 位属于第 j 个分组），
+// S 盒在复合域 GF((2^4)^2) 上以布尔电路求逆，全程无查表、与数据无关的分支，
+// 循环移位构成的线性变换 L 在比特平面上只是下标重排。
+// 256 位比特平面：4 组 64 分组拼成一个 YMM，一次处理 256 个分组。
+// 下面的比特切片模板不带目标属性，强制内联到 AVX2 入口后按 AVX2 编译（入口再用 flatten 内联各运算符），
+// 保证 bs256 只在 AVX2 函数之间按值传递
+struct bs256 {
+    __m256i v;
+    SM4_TARGET("avx2") friend bs256 operator^(bs256 a, bs256 b) { return { _mm256_xor_si256(a.v, b.v) }; }
+    SM4_TARGET("avx2") friend bs256 operator&(bs256 a, bs256 b) { return { _mm256_and_si256(a.v, b.v) }; }
+    SM4_TARGET("avx2") friend bs256 operator~(bs256 a) { return { _mm256_xor_si256(a.v, _mm256_set1_epi32(-1)) }; }
+};
+SM4_TARGET("avx2") static inline bs256 bs_fill(bs256, u32 bit) { return { _mm256_set1_epi32(-(int)bit) }; }
+static inline u64 bs_fill(u64, u32 bit) { return (u64)0 - bit; }
+
+// GF(2^4) 乘法，模多项式 z^4 + z + 1
+template<typename W>
+static SM4_FORCEINLINE void bs_gf16_mul(W c[4], const W a[4], const W b[4]) {
+    W p0 = a[0] & b[0];
+    W p1 = (a[0] & b[1]) ^ (a[1] & b[0]);
+    W p2 = (a[0] & b[2]) ^ (a[1] & b[1]) ^ (a[2] & b[0]);
+    W p3 = (a[0] & b[3]) ^ (a[1] & b[2]) ^ (a[2] & b[1]) ^ (a[3] & b[0]);
+    W p4 = (a[1] & b[3]) ^ (a[2] & b[2]) ^ (a[3] & b[1]);
+    W p5 = (a[2] & b[3]) ^ (a[3] & b[2]);
+    W p6 = a[3] & b[3];
+    c[0] = p0 ^ p4;
+    c[1] = p1 ^ p4 ^ p5;
+    c[2] = p2 ^ p5 ^ p6;
+    c[3] = p3 ^ p6;
+}
+
+// GF(2^4) 求逆（0 映射到 0），由各输出位的代数正规型直接展开
+template<typename W>
+static SM4_FORCEINLINE void bs_gf16_inv(W r[4], const W a[4]) {
+    W a01 = a[0] & a[1], a02 = a[0] & a[2], a03 = a[0] & a[3];
+    W a12 = a[1] & a[2], a13 = a[1] & a[3], a23 = a[2] & a[3];
+    W a012 = a01 & a[2], a013 = a01 & a[3], a023 = a02 & a[3], a123 = a12 & a[3];
+    r[0] = a[0] ^ a[1] ^ a[2] ^ a[3] ^ a02 ^ a12 ^ a012 ^ a123;
+    r[1] = a01 ^ a02 ^ a12 ^ a[3] ^ a13 ^ a013;
+    r[2] = a01 ^ a[2] ^ a02 ^ a[3] ^ a03 ^ a023;
+    r[3] = a[1] ^ a[2] ^ a[3] ^ a03 ^ a13 ^ a23 ^ a123;
+}
+
+// SM4 S盒：S(x) = A·I(A·x + 0xD3) + 0xD3，I 为 GF(2^8)/(x^8+x^7+x^6+x^5+x^4+x^2+1) 上求逆。
+// 求逆前把元素同构到 GF((2^4)^2)（y^2 + y + λ，λ = z^3 + 1），输入/输出仿射与同构矩阵合并。
+// x[0..7] 为一个字节的 8 个比特平面（x[0] 为最低位），原地替换。
+template<typename W>
+static SM4_FORCEINLINE void bs_sm4_sbox(W x[8]) {
+    W a0[4], a1[4];
+    a0[0] = ~(x[4] ^ x[5] ^ x[6] ^ x[7]);
+    a0[1] = ~(x[1] ^ x[4] ^ x[5] ^ x[6]);
+    a0[2] = ~(x[1] ^ x[2] ^ x[4] ^ x[6] ^ x[7]);
+    a0[3] = ~(x[3] ^ x[4]);
+    a1[0] = x[0] ^ x[1] ^ x[4] ^ x[7];
+    a1[1] = ~x[6];
+    a1[2] = x[2] ^ x[6] ^ x[7];
+    a1[3] = ~(x[0] ^ x[1] ^ x[2] ^ x[3] ^ x[4] ^ x[5] ^ x[6]);
+
+    // d = λ·a1^2 + a1·a0 + a0^2
+    W m[4], d[4], di[4];
+    bs_gf16_mul(m, a1, a0);
+    d[0] = m[0] ^ a1[0] ^ a0[0] ^ a0[2];
+    d[1] = m[1] ^ a1[1] ^ a1[3] ^ a0[2];
+    d[2] = m[2] ^ a1[3] ^ a0[1] ^ a0[3];
+    d[3] = m[3] ^ a1[0] ^ a1[2] ^ a0[3];
+    bs_gf16_inv(di, d);
+
+    // (a1·y + a0)^-1 = (a1·d^-1)·y + (a0 + a1)·d^-1
+    W s[4], b0[4], b1[4];
+    for (int i = 0; i < 4; ++i) s[i] = a0[i] ^ a1[i];
+    bs_gf16_mul(b1, a1, di);
+    bs_gf16_mul(b0, s, di);
+
+    x[0] = ~(b0[0] ^ b0[1] ^ b1[0] ^ b1[1]);
+    x[1] = ~(b0[0] ^ b0[2] ^ b1[1] ^ b1[2]);
+    x[2] = b0[2] ^ b1[0];
+    x[3] = b0[0] ^ b0[2] ^ b1[0] ^ b1[1] ^ b1[3];
+    x[4] = ~(b0[1] ^ b0[3] ^ b1[3]);
+    x[5] = b0[1] ^ b0[3] ^ b1[1];
+    x[6] = ~(b0[0] ^ b0[1] ^ b0[2]);
+    x[7] = ~(b0[0] ^ b0[3] ^ b1[1]);
+}
+
+// 比特平面上的 32 轮迭代，X[w][k] 为第 w 个字的第 k 位平面
+template<typename W>
+static SM4_FORCEINLINE void bs_sm4_rounds(W X[4][32], const u32 rk[32]) {
+    for (int r = 0; r < 32; ++r) {
+        W* x0 = X[r & 3];
+        const W* x1 = X[(r + 1) & 3];
+        const W* x2 = X[(r + 2) & 3];
+        const W* x3 = X[(r + 3) & 3];
+        W t[32];
+        for (int k = 0; k < 32; ++k)
+            t[k] = x1[k] ^ x2[k] ^ x3[k] ^ bs_fill(W(), (rk[r] >> k) & 1);
+        for (int q = 0; q < 4; ++q) bs_sm4_sbox(t + 8 * q);
+        // L(B) = B ^ (B<<<2) ^ (B<<<10) ^ (B<<<18) ^ (B<<<24)
+        for (int k = 0; k < 32; ++k)
+            x0[k] = x0[k] ^ t[k] ^ t[(k + 30) & 31] ^ t[(k + 22) & 31] ^ t[(k + 14) & 31] ^ t[(k + 8) & 31];
+    }
+}
+
+// 64x64 比特矩阵转置：a[i] 的第 j 位与 a[j] 的第 i 位互换
+static void transpose64(u64 a[64]) {
+    static const u64 M[6] = {
+        0x00000000FFFFFFFFULL, 0x0000FFFF0000FFFFULL, 0x00FF00FF00FF00FFULL,
+        0x0F0F0F0F0F0F0F0FULL, 0x3333333333333333ULL, 0x5555555555555555ULL
+    };
+    for (int s = 0, j = 32; s < 6; ++s, j >>= 1) {
+        for (int k0 = 0; k0 < 64; k0 += 2 * j) {
+            for (int k = k0; k < k0 + j; ++k) {
+                u64 t = ((a[k] >> j) ^ a[k + j]) & M[s];
+                a[k + j] ^= t;
+                a[k] ^= t << j;
+            }
+        }
+    }
+}
+
+static inline u32 load_be32(const u8* b) {
+    return (u32(b[0]) << 24) | (u32(b[1]) << 16) | (u32(b[2]) << 8) | u32(b[3]);
+}
+
+// 64 个分组 -> 128 个比特平面，P[32 * w + k] 为第 w 个字的第 k 位
+static void bs_pack64(const u8* in, u64 P[128]) {
+    u64* lo = P;        // 字 0、字 1
+    u64* hi = P + 64;   // 字 2、字 3
+    for (int j = 0; j < 64; ++j) {
+        const u8* b = in + 16 * j;
+        lo[j] = ((u64)load_be32(b + 4) << 32) | load_be32(b);
+        hi[j] = ((u64)load_be32(b + 12) << 32) | load_be32(b + 8);
+    }
+    transpose64(lo);
+    transpose64(hi);
+}
+
+// 128 个比特平面 -> 64 个分组，输出字序为 X35, X34, X33, X32
+static void bs_unpack64(u64 P[128], u8* out) {
+    u64* lo = P;
+    u64* hi = P + 64;
+    transpose64(lo);
+    transpose64(hi);
+    // 此时 hi[j] = (X3 << 32) | X2，lo[j] = (X1 << 32) | X0，恰为反序输出的大端字节序
+    for (int j = 0; j < 64; ++j) {
+        u64 w32 = hi[j];
+        u64 w10 = lo[j];
+        u8* b = out + 16 * j;
+        for (int i = 0; i < 8; ++i) {
+            b[i] = (u8)(w32 >> (56 - 8 * i));
+            b[8 + i] = (u8)(w10 >> (56 - 8 * i));
+        }
+    }
+}
+
+// 一次加密 64 个 16 字节分组（in/out 可以相同）
+inline void sm4_encrypt_64blocks_bitslice(const u8* in, u8* out, const u32 rk[32]) {
+    u64 P[128];
+    bs_pack64(in, P);
+    bs_sm4_rounds(reinterpret_cast<u64(*)[32]>(P), rk);
+    bs_unpack64(P, out);
+}
+
+// 一次加密 256 个 16 字节分组：每 64 个分组单独转置，再按平面拼成 YMM
+SM4_TARGET_FLATTEN("avx2") inline void sm4_encrypt_256blocks_bitslice_avx2(const u8* in, u8* out, const u32 rk[32]) {
+    alignas(32) u64 P[4][128];
+    bs256 X[4][32];
+    for (int g = 0; g < 4; ++g) bs_pack64(in + g * 64 * 16, P[g]);
+    for (int k = 0; k < 128; ++k)
+        X[k >> 5][k & 31].v = _mm256_set_epi64x((long long)P[3][k], (long long)P[2][k],
+            (long long)P[1][k], (long long)P[0][k]);
+    bs_sm4_rounds(X, rk);
+    for (int k = 0; k < 128; ++k) {
+        alignas(32) u64 lane[4];
+        _mm256_store_si256((__m256i*)lane, X[k >> 5][k & 31].v);
+        for (int g = 0; g < 4; ++g) P[g][k] = lane[g];
+    }
+    for (int g = 0; g < 4; ++g) bs_unpack64(P[g], out + g * 64 * 16);
+}
+
+// 比特切片一次能处理的分组数：支持 AVX2 时 256，否则 64
+static inline size_t bs_batch() {
+    return (sm4_cpu_features() & SM4_CPU_AVX2) ? 256 : 64;
+}
+static inline void bs_encrypt_batch(const u8* in, u8* out, const u32 rk[32]) {
+    if (sm4_cpu_features() & SM4_CPU_AVX2)
+        sm4_encrypt_256blocks_bitslice_avx2(in, out, rk);
+    else
+        sm4_encrypt_64blocks_bitslice(in, out, rk);
+}
+
+// ECB 批量加密，尾部不足一批的分组补零后整批计算
+inline void sm4_ecb_encrypt_bitslice(const u8* in, u8* out, size_t nblocks, const u32 rk[32]) {
+    const size_t BS_BATCH = bs_batch();
+    while (nblocks >= BS_BATCH) {
+        bs_encrypt_batch(in, out, rk);
+        in += BS_BATCH * 16; out += BS_BATCH * 16; nblocks -= BS_BATCH;
+    }
+    if (nblocks) {
+        std::vector<u8> buf(BS_BATCH * 16, 0);
+        memcpy(buf.data(), in, nblocks * 16);
+        bs_encrypt_batch(buf.data(), buf.data(), rk);
+        memcpy(out, buf.data(), nblocks * 16);
+    }
+}
+
+// 128 位大端计数器加 1
+static inline void ctr128_inc(u8 ctr[16]) {
+    for (int i = 15; i >= 0; --i) {
+        if (++ctr[i]) break;
+    }
+}
+
+// CTR 模式批量加/解密：整批生成计数器分组，一次比特切片得到密钥流后异或
+inline void sm4_ctr_encrypt_bitslice(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    const size_t BS_BATCH = bs_batch();
+    std::vector<u8> ks(BS_BATCH * 16);
+    u8 ctr[16];
+    memcpy(ctr, iv, 16);
+    while (len) {
+        for (size_t j = 0; j < BS_BATCH; ++j) {
+            memcpy(&ks[16 * j], ctr, 16);
+            ctr128_inc(ctr);
+        }
+        bs_encrypt_batch(ks.data(), ks.data(), rk);
+        size_t n = len < BS_BATCH * 16 ? len : BS_BATCH * 16;
+        for (size_t i = 0; i < n; ++i) out[i] = in[i] ^ ks[i];
+        in += n; out += n; len -= n;
+    }
+}
+
+
+// 运行时内核选择：按 CPUID 结果绑定单分组与多分组加密函数，
+// 环境变量 SM4_KERNEL（或 SM4_DISPATCH.select）可强制指定某个内核，便于基准测试对比
+typedef void (*sm4_block_fn)(const u8 in[16], u8 out[16], const u32 rk[32]);
+
+struct Sm4KernelInfo {
+    const char* name;
+    u32 need;            // 所需 CPU 特性
+    sm4_multi_fn multi;  // 一次加密 nblocks 个分组
+    int nblocks;
+    bool const_time;     // 不查与数据相关的表
+};
+
+// 既没有 SSSE3 也没有 GFNI 时常数时间的单分组只能借用比特切片：补齐成一整批计算
+inline void sm4_encrypt_block_bitslice(const u8 in[16], u8 out[16], const u32 rk[32]) {
+    u8 buf[64 * 16] = { 0 };
+    memcpy(buf, in, 16);
+    sm4_encrypt_64blocks_bitslice(buf, buf, rk);
+    memcpy(out, buf, 16);
+}
+
+// 按自动选择时的优先顺序排列。没有 SIMD 时常数时间的 bitslice 排在更快的 ttable-x4 之前：
+// 查表的地址与数据相关，存在缓存计时侧信道，ttable-x4 只在用 SM4_KERNEL 指定时使用
+static const Sm4KernelInfo SM4_KERNELS[] = {
+    { "avx512-gfni", SM4_CPU_AVX512F | SM4_CPU_AVX512BW | SM4_CPU_GFNI, sm4_encrypt_16blocks_avx512_gfni, 16, true },
+    { "avx2-gfni", SM4_CPU_AVX2 | SM4_CPU_GFNI, sm4_encrypt_8blocks_avx2_gfni, 8, true },
+    { "avx512-nibble", SM4_CPU_AVX512F | SM4_CPU_AVX512BW, sm4_encrypt_16blocks_avx512_nibble, 16, true },
+    { "aesni", SM4_CPU_AESNI | SM4_CPU_SSSE3, sm4_encrypt_16blocks_aesni, 16, true },
+    { "avx2-nibble", SM4_CPU_AVX2, sm4_encrypt_8blocks_avx2_nibble, 8, true },
+    { "bitslice-avx2", SM4_CPU_AVX2, sm4_encrypt_256blocks_bitslice_avx2, 256, true },
+    { "avx2-gather", SM4_CPU_AVX2, sm4_encrypt_8blocks_avx2, 8, false },
+    { "bitslice", 0, sm4_encrypt_64blocks_bitslice, 64, true },
+    { "ttable-x4", 0, sm4_encrypt_4blocks_ttable, 4, false },
+    { "ttable", 0, sm4_encrypt_block_ttable, 1, false },
+    { "basic", 0, sm4_encrypt_block, 1, false },
+};
+static const int SM4_KERNEL_COUNT = sizeof(SM4_KERNELS) / sizeof(SM4_KERNELS[0]);
+static const int SM4_MAX_MULTI_BLOCKS = 256;  // 最宽内核 bitslice-avx2 一次的分组数
+
+// 初值即为 basic，init 失败或尚未执行时调用方也不会拿到空指针
+struct SM4_DISPATCH_TABLE {
+    u32 cpu = 0;
+    bool tables_ok = false;
+    std::once_flag once;
+    const Sm4KernelInfo* kernel = &SM4_KERNELS[SM4_KERNEL_COUNT - 1];
+    sm4_block_fn encrypt_block = sm4_encrypt_block;  // 单分组，见 bind
+    sm4_multi_fn encrypt_multi = sm4_encrypt_block;
+    int multi_blocks = 1;
+    size_t tail_pad = 1;  // sm4_encrypt_blocks 的尾部达到这么多块时补齐成一整批
+
+    bool supported(const Sm4KernelInfo& k) const { return (cpu & k.need) == k.need; }
+
+    // 单分组路径跟随内核的性质：常数时间内核配 GFNI / SSSE3 的单分组实现（都没有时借用比特切片），
+    // 查表内核配 T 表，强制 basic 时仍为基础实现
+    static sm4_block_fn block_fn_for(const Sm4KernelInfo& k, u32 cpu) {
+        if (k.multi == sm4_encrypt_block) return sm4_encrypt_block;
+        if (!k.const_time) return sm4_encrypt_block_ttable;
+        if (cpu & SM4_CPU_GFNI) return sm4_encrypt_block_gfni;
+        if (cpu & SM4_CPU_SSSE3) return sm4_encrypt_block_ssse3;
+        return sm4_encrypt_block_bitslice;
+    }
+
+    void bind(const Sm4KernelInfo& k) {
+        kernel = &k;
+        encrypt_multi = k.multi;
+        multi_blocks = k.nblocks;
+        encrypt_block = block_fn_for(k, cpu);
+        // SIMD 内核一整批与一个单分组耗时相当（avx512-gfni 16 块约 340ns，GFNI 单分组约 370ns），
+        // 比特切片一批约合 W/6 个单分组；单分组本身就借用比特切片时总是补齐
+        if (k.nblocks <= 16) tail_pad = 2;
+        else tail_pad = (encrypt_block == sm4_encrypt_block_bitslice) ? 1 : (size_t)k.nblocks / 6;
+    }
+
+    // 按名称强制选择内核，name 为空或 "auto" 时选本机支持且自检通过的最快内核；
+    // 名称未知或 CPU 不支持时返回 false，保持原选择不变
+    bool select(const char* name) {
+        u32 rk[32];
+        const u8 key[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
+        sm4_key_expand(key, rk);
+        bool automatic = name == nullptr || strcmp(name, "auto") == 0;
+        for (int i = 0; i < SM4_KERNEL_COUNT; ++i) {
+            const Sm4KernelInfo& k = SM4_KERNELS[i];
+            if (!automatic && strcmp(name, k.name) != 0) continue;
+            if (!supported(k)) {
+                if (automatic) continue;
+                return false;
+            }
+            if (automatic && !(sm4_kernel_self_check(k.multi, k.nblocks, rk) &&
+                sm4_kernel_self_check(block_fn_for(k, cpu), 1, rk))) continue;
+            bind(k);
+            return true;
+        }
+        return false;
+    }
+
+    // 探测 CPU、构造各内核用到的表并选择内核。由 call_once 保证只执行一次，多个线程同时
+    // 首次调用时其余线程等它完成后再返回；查找表构造失败时保持 basic 并返回 false
+    bool init() {
+        std::call_once(once, [this] { tables_ok = init_once(); });
+        return tables_ok;
+    }
+
+private:
+    bool init_once() {
+        cpu = sm4_cpu_features();
+        TTABLE.init_from_sbox();
+        if (!NIBBLE_TABLE.init_from_sbox() || !GFNI_TABLE.init_from_sbox()) return false;
+        if ((cpu & SM4_CPU_AESNI) && !AESNI_TABLE.init_from_sbox()) return false;
+        const char* env = getenv("SM4_KERNEL");
+        if (env && *env && !select(env)) {
+            fprintf(stderr, "SM4_KERNEL=%s 未知或本机不支持，改为自动选择\n", env);
+            env = nullptr;
+        }
+        if (!env || !*env) select(nullptr);
+        return true;
+    }
+};
+inline SM4_DISPATCH_TABLE SM4_DISPATCH;
+
+// 任意分组数的批量加密（in/out 可以相同）：按所选内核的宽度整批处理，
+// 尾部较长时在栈上补齐成一批交给同一内核，否则逐块走 encrypt_block
+inline void sm4_encrypt_blocks(const u8* in, u8* out, size_t nblocks, const u32 rk[32]) {
+    SM4_DISPATCH.init();
+    const size_t w = (size_t)SM4_DISPATCH.multi_blocks;
+    for (; nblocks >= w; nblocks -= w, in += 16 * w, out += 16 * w)
+        SM4_DISPATCH.encrypt_multi(in, out, rk);
+    if (nblocks && nblocks >= SM4_DISPATCH.tail_pad) {
+        alignas(32) u8 buf[SM4_MAX_MULTI_BLOCKS * 16];
+        memcpy(buf, in, 16 * nblocks);
+        memset(buf + 16 * nblocks, 0, 16 * (w - nblocks));
+        SM4_DISPATCH.encrypt_multi(buf, buf, rk);
+        memcpy(out, buf, 16 * nblocks);
+        return;
+    }
+    for (; nblocks; --nblocks, in += 16, out += 16)
+        SM4_DISPATCH.encrypt_block(in, out, rk);
+}
+
+// 解密接口，rk_dec 由 sm4_key_expand_dec 生成
+inline void sm4_decrypt_block(const u8 in[16], u8 out[16], const u32 rk_dec[32]) {
+    SM4_DISPATCH.init();
+    SM4_DISPATCH.encrypt_block(in, out, rk_dec);
+}
+
+inline void sm4_decrypt_blocks(const u8* in, u8* out, size_t nblocks, const u32 rk_dec[32]) {
+    sm4_encrypt_blocks(in, out, nblocks, rk_dec);
+}
+
+// 批量密钥扩展：8 个密钥按分组载入并转置，K[w] 的第 i 个通道为第 i 个密钥的第 w 个字，
+// 32 轮密钥扩展在 8 个通道中同时进行（τ 用与加密内核相同的 S 盒实现），结果先按轮写入
+// soa[r][i]，再转置为每个密钥的加密轮密钥，rk_dec 不为空时同时写出逆序的解密轮密钥
+static inline void sm4_key_soa_store(const u32 soa[32][8], u32 (*rk)[32], u32 (*rk_dec)[32]) {
+    for (int k = 0; k < 8; ++k) {
+        for (int r = 0; r < 32; ++r) rk[k][r] = soa[r][k];
+        if (rk_dec) for (int r = 0; r < 32; ++r) rk_dec[k][31 - r] = soa[r][k];
+    }
+}
+
+SM4_TARGET("avx2") static inline __m256i sm4_key_L_avx2(__m256i s) {
+    return _mm256_xor_si256(s, _mm256_xor_si256(
+        _mm256_or_si256(_mm256_slli_epi32(s, 13), _mm256_srli_epi32(s, 19)),
+        _mm256_or_si256(_mm256_slli_epi32(s, 23), _mm256_srli_epi32(s, 9))));
+}
+
+SM4_TARGET("avx2") inline void sm4_key_expand8_avx2_nibble(const u8* keys, u32 (*rk)[32], u32 (*rk_dec)[32]) {
+    alignas(32) u32 soa[32][8];
+    __m256i K[4];
+    sm4_avx2_load8(keys, K);
+    for (int w = 0; w < 4; ++w) K[w] = _mm256_xor_si256(K[w], _mm256_set1_epi32((int)FK[w]));
+    for (int r = 0; r < 32; ++r) {
+        __m256i t = _mm256_xor_si256(_mm256_xor_si256(K[(r + 1) & 3], K[(r + 2) & 3]),
+            _mm256_xor_si256(K[(r + 3) & 3], _mm256_set1_epi32((int)CK[r])));
+        K[r & 3] = _mm256_xor_si256(K[r & 3], sm4_key_L_avx2(sm4_sbox_nibble_avx2(t)));
+        _mm256_store_si256((__m256i*)soa[r], K[r & 3]);
+    }
+    sm4_key_soa_store(soa, rk, rk_dec);
+}
+
+SM4_TARGET("avx2,gfni") inline void sm4_key_expand8_avx2_gfni(const u8* keys, u32 (*rk)[32], u32 (*rk_dec)[32]) {
+    alignas(32) u32 soa[32][8];
+    __m256i K[4];
+    sm4_avx2_load8(keys, K);
+    for (int w = 0; w < 4; ++w) K[w] = _mm256_xor_si256(K[w], _mm256_set1_epi32((int)FK[w]));
+    for (int r = 0; r < 32; ++r) {
+        __m256i t = _mm256_xor_si256(_mm256_xor_si256(K[(r + 1) & 3], K[(r + 2) & 3]),
+            _mm256_xor_si256(K[(r + 3) & 3], _mm256_set1_epi32((int)CK[r])));
+        K[r & 3] = _mm256_xor_si256(K[r & 3], sm4_key_L_avx2(sm4_sbox_gfni_avx2(t)));
+        _mm256_store_si256((__m256i*)soa[r], K[r & 3]);
+    }
+    sm4_key_soa_store(soa, rk, rk_dec);
+}
+
+// n 个密钥（每个 16 字节，连续存放）的加密轮密钥，rk_dec 不为空时同时生成解密轮密钥。
+// 有 AVX2 时每 8 个一组在向量通道中扩展，不足 8 个的尾部补齐后同样处理，其余逐个调用 sm4_key_expand
+inline void sm4_key_expand_batch(const u8* keys, size_t n, u32 (*rk)[32], u32 (*rk_dec)[32]) {
+    SM4_DISPATCH.init();
+    void (*fn)(const u8*, u32 (*)[32], u32 (*)[32]) = nullptr;
+    if ((SM4_DISPATCH.cpu & (SM4_CPU_AVX2 | SM4_CPU_GFNI)) == (SM4_CPU_AVX2 | SM4_CPU_GFNI)) fn = sm4_key_expand8_avx2_gfni;
+    else if (SM4_DISPATCH.cpu & SM4_CPU_AVX2) fn = sm4_key_expand8_avx2_nibble;
+    size_t i = 0;
+    if (fn) {
+        for (; i + 8 <= n; i += 8) fn(keys + 16 * i, rk + i, rk_dec ? rk_dec + i : nullptr);
+        // 尾部很短时补齐的通道比逐个扩展更费时，少于 4 个时留给下面的标量循环
+        if (n - i >= 4) {
+            u8 tail[8 * 16] = { 0 };
+            u32 trk[8][32], trk_dec[8][32];
+            memcpy(tail, keys + 16 * i, 16 * (n - i));
+            fn(tail, trk, rk_dec ? trk_dec : nullptr);
+            memcpy(rk + i, trk, sizeof(trk[0]) * (n - i));
+            if (rk_dec) memcpy(rk_dec + i, trk_dec, sizeof(trk_dec[0]) * (n - i));
+            i = n;
+        }
+    }
+    for (; i < n; ++i) {
+        sm4_key_expand(keys + 16 * i, rk[i]);
+        if (rk_dec) for (int r = 0; r < 32; ++r) rk_dec[i][31 - r] = rk[i][r];
+    }
+}
+
+// 分组工作模式。可并行的方向（ECB 加解密、CBC/CFB 解密、CTR）每次把 SM4_MODE_CHUNK 个分组
+// 交给 sm4_encrypt_blocks，由所选的多分组内核处理；CBC/CFB 加密与 OFB 前后依赖，只能逐块。
+// 所有接口都允许 in == out。ECB/CBC 要求长度为 16 的倍数（不满足时返回 false），
+// 需要任意长度时用带 _pkcs7 后缀的版本；CFB/OFB/CTR 支持任意长度。
+static const size_t SM4_MODE_CHUNK = 256;
+
+static inline void xor_block(u8* out, const u8* a, const u8* b) {
+    for (int i = 0; i < 16; ++i) out[i] = a[i] ^ b[i];
+}
+
+// 任意长度异或，按 8 字节一组处理（memcpy 避免未对齐访问的未定义行为）
+static inline void xor_bytes(u8* out, const u8* a, const u8* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        u64 x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x ^= y;
+        memcpy(out + i, &x, 8);
+    }
+    for (; i < n; ++i) out[i] = a[i] ^ b[i];
+}
+
+inline bool sm4_ecb_encrypt(const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    if (len % 16) return false;
+    sm4_encrypt_blocks(in, out, len / 16, rk);
+    return true;
+}
+
+inline bool sm4_ecb_decrypt(const u8* in, u8* out, size_t len, const u32 rk_dec[32]) {
+    if (len % 16) return false;
+    sm4_decrypt_blocks(in, out, len / 16, rk_dec);
+    return true;
+}
+
+inline bool sm4_cbc_encrypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    if (len % 16) return false;
+    SM4_DISPATCH.init();
+    u8 chain[16];
+    memcpy(chain, iv, 16);
+    for (; len; len -= 16, in += 16, out += 16) {
+        xor_block(chain, chain, in);
+        SM4_DISPATCH.encrypt_block(chain, chain, rk);
+        memcpy(out, chain, 16);
+    }
+    return true;
+}
+
+// P_i = D(C_i) ^ C_{i-1}：整批解密后从后往前异或，原地解密时前一个密文分组尚未被覆盖
+inline bool sm4_cbc_decrypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk_dec[32]) {
+    if (len % 16) return false;
+    u8 buf[SM4_MODE_CHUNK * 16];
+    u8 chain[16], next[16];
+    memcpy(chain, iv, 16);
+    size_t nblocks = len / 16;
+    while (nblocks) {
+        size_t n = nblocks < SM4_MODE_CHUNK ? nblocks : SM4_MODE_CHUNK;
+        sm4_decrypt_blocks(in, buf, n, rk_dec);
+        memcpy(next, in + 16 * (n - 1), 16);
+        for (size_t i = n - 1; i > 0; --i) xor_block(out + 16 * i, buf + 16 * i, in + 16 * (i - 1));
+        xor_block(out, buf, chain);
+        memcpy(chain, next, 16);
+        in += 16 * n; out += 16 * n; nblocks -= n;
+    }
+    return true;
+}
+
+// CFB-128：C_i = P_i ^ E(C_{i-1})，最后不足一块时截断
+inline void sm4_cfb_encrypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    SM4_DISPATCH.init();
+    u8 chain[16], ks[16];
+    memcpy(chain, iv, 16);
+    while (len) {
+        size_t n = len < 16 ? len : 16;
+        SM4_DISPATCH.encrypt_block(chain, ks, rk);
+        for (size_t i = 0; i < n; ++i) chain[i] = out[i] = in[i] ^ ks[i];
+        in += n; out += n; len -= n;
+    }
+}
+
+// CFB 解密用的也是加密方向：密钥流 E(C_{i-1}) 只依赖密文，可以整批计算
+inline void sm4_cfb_decrypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    u8 src[SM4_MODE_CHUNK * 16], ks[SM4_MODE_CHUNK * 16];
+    u8 chain[16];
+    memcpy(chain, iv, 16);
+    while (len) {
+        size_t bytes = len < SM4_MODE_CHUNK * 16 ? len : SM4_MODE_CHUNK * 16;
+        size_t n = (bytes + 15) / 16;
+        memcpy(src, chain, 16);
+        memcpy(src + 16, in, 16 * (n - 1));
+        if (bytes == 16 * n) memcpy(chain, in + 16 * (n - 1), 16);
+        sm4_encrypt_blocks(src, ks, n, rk);
+        xor_bytes(out, in, ks, bytes);
+        in += bytes; out += bytes; len -= bytes;
+    }
+}
+
+// OFB：O_i = E(O_{i-1})，密钥流与明文无关但前后依赖，加解密相同
+inline void sm4_ofb_crypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    SM4_DISPATCH.init();
+    u8 ks[16];
+    memcpy(ks, iv, 16);
+    while (len) {
+        size_t n = len < 16 ? len : 16;
+        SM4_DISPATCH.encrypt_block(ks, ks, rk);
+        for (size_t i = 0; i < n; ++i) out[i] = in[i] ^ ks[i];
+        in += n; out += n; len -= n;
+    }
+}
+
+// CTR：计数器分组按 128 位大端整数递增，整批加密得到密钥流，加解密相同
+inline void sm4_ctr_crypt(const u8 iv[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    u8 ks[SM4_MODE_CHUNK * 16];
+    u8 ctr[16];
+    memcpy(ctr, iv, 16);
+    while (len) {
+        size_t bytes = len < SM4_MODE_CHUNK * 16 ? len : SM4_MODE_CHUNK * 16;
+        size_t n = (bytes + 15) / 16;
+        for (size_t j = 0; j < n; ++j) {
+            memcpy(ks + 16 * j, ctr, 16);
+            ctr128_inc(ctr);
+        }
+        sm4_encrypt_blocks(ks, ks, n, rk);
+        xor_bytes(out, in, ks, bytes);
+        in += bytes; out += bytes; len -= bytes;
+    }
+}
+
+// GCM 的 inc32：只有最后 4 字节作为 32 位大端计数器递增，溢出时回绕，不向前 12 字节进位
+static inline void ctr32_add(u8 ctr[16], u32 n) {
+    u32 c = ((u32)ctr[12] << 24) | ((u32)ctr[13] << 16) | ((u32)ctr[14] << 8) | ctr[15];
+    c += n;
+    ctr[12] = (u8)(c >> 24); ctr[13] = (u8)(c >> 16); ctr[14] = (u8)(c >> 8); ctr[15] = (u8)c;
+}
+
+// 连续写出 n 个计数器分组 ctr, inc32(ctr), ...，ctr 前进 n
+static inline void ctr32_fill(u8* cb, u8 ctr[16], size_t n) {
+    u32 c = ((u32)ctr[12] << 24) | ((u32)ctr[13] << 16) | ((u32)ctr[14] << 8) | ctr[15];
+    for (size_t j = 0; j < n; ++j, ++c) {
+        u8* p = cb + 16 * j;
+        memcpy(p, ctr, 12);
+        p[12] = (u8)(c >> 24); p[13] = (u8)(c >> 16); p[14] = (u8)(c >> 8); p[15] = (u8)c;
+    }
+    ctr32_add(ctr, (u32)n);
+}
+
+// 按 inc32 递增计数器的 CTR（即 sm4_gcm_encrypt 中的 GCTR），ctr0 为第一个计数器分组
+inline void sm4_ctr32_crypt(const u8 ctr0[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    u8 ks[SM4_MODE_CHUNK * 16];
+    u8 ctr[16];
+    memcpy(ctr, ctr0, 16);
+    while (len) {
+        size_t bytes = len < SM4_MODE_CHUNK * 16 ? len : SM4_MODE_CHUNK * 16;
+        size_t n = (bytes + 15) / 16;
+        ctr32_fill(ks, ctr, n);
+        sm4_encrypt_blocks(ks, ks, n, rk);
+        xor_bytes(out, in, ks, bytes);
+        in += bytes; out += bytes; len -= bytes;
+    }
+}
+
+// PKCS#7 填充：out 需要 (len / 16 + 1) * 16 字节，返回密文长度
+inline size_t sm4_ecb_encrypt_pkcs7(const u8* in, size_t len, u8* out, const u32 rk[32]) {
+    size_t full = len - len % 16;
+    u8 last[16];
+    u8 pad = (u8)(16 - len % 16);
+    memcpy(last, in + full, len % 16);
+    memset(last + len % 16, pad, pad);
+    sm4_ecb_encrypt(in, out, full, rk);
+    sm4_ecb_encrypt(last, out + full, 16, rk);
+    return full + 16;
+}
+
+inline size_t sm4_cbc_encrypt_pkcs7(const u8 iv[16], const u8* in, size_t len, u8* out, const u32 rk[32]) {
+    size_t full = len - len % 16;
+    u8 last[16];
+    u8 pad = (u8)(16 - len % 16);
+    memcpy(last, in + full, len % 16);
+    memset(last + len % 16, pad, pad);
+    sm4_cbc_encrypt(iv, in, out, full, rk);
+    const u8* chain = full ? out + full - 16 : iv;
+    sm4_cbc_encrypt(chain, last, out + full, 16, rk);
+    return full + 16;
+}
+
+// 去填充：填充字节不合法时返回 false。检查按常数时间进行，不因填充长度提前返回
+static bool sm4_pkcs7_unpad(const u8* out, size_t len, size_t* out_len) {
+    if (len == 0 || len % 16) return false;
+    u8 pad = out[len - 1];
+    u32 bad = (u32)(pad == 0) | (u32)(pad > 16);
+    for (u32 i = 1; i <= 16; ++i) {
+        u32 in_pad = (u32)(i <= pad);
+        bad |= in_pad & (u32)(out[len - i] != pad);
+    }
+    if (bad) return false;
+    *out_len = len - pad;
+    return true;
+}
+
+inline bool sm4_ecb_decrypt_pkcs7(const u8* in, size_t len, u8* out, size_t* out_len, const u32 rk_dec[32]) {
+    return sm4_ecb_decrypt(in, out, len, rk_dec) && sm4_pkcs7_unpad(out, len, out_len);
+}
+
+inline bool sm4_cbc_decrypt_pkcs7(const u8 iv[16], const u8* in, size_t len, u8* out, size_t* out_len, const u32 rk_dec[32]) {
+    return sm4_cbc_decrypt(iv, in, out, len, rk_dec) && sm4_pkcs7_unpad(out, len, out_len);
+}
+
+// ---------------------------
+// SM4-XTS（IEEE 1619 的 XTS 结构，分组密码换为 SM4），用于扇区/对象的静态加密。
+// 密钥为两个 16 字节的 SM4 密钥 K1 || K2：T0 = E_K2(调整值)，第 j 个分组的调整值 T_j = T0·α^j
+// （GF(2^128) 小端表示，约简多项式 x^128 + x^7 + x^2 + x + 1），C_j = E_K1(P_j ^ T_j) ^ T_j。
+// 长度不是 16 的倍数时最后两块用密文挪用（ciphertext stealing），长度至少 16 字节。
+// ---------------------------
+struct Sm4XtsKey {
+    alignas(64) u32 rk1[32];
+    alignas(64) u32 rk1_dec[32];
+    alignas(64) u32 rk2[32];
+
+    // key 为 32 字节；K1 与 K2 相同时 XTS 的安全性不成立，返回 false
+    bool init(const u8 key[32]) {
+        if (memcmp(key, key + 16, 16) == 0) return false;
+        u32 rk[2][32];
+        sm4_key_expand_batch(key, 2, rk, nullptr);
+        memcpy(rk1, rk[0], sizeof(rk1));
+        memcpy(rk2, rk[1], sizeof(rk2));
+        for (int r = 0; r < 32; ++r) rk1_dec[r] = rk1[31 - r];
+        return true;
+    }
+};
+
+// T·α：128 位小端整数左移一位，移出的最高位以 0x87 约简回最低字节
+static inline void xts_mul_alpha(u8 t[16]) {
+    u64 lo, hi;
+    memcpy(&lo, t, 8);
+    memcpy(&hi, t + 8, 8);
+    u64 c = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ (0x87 & (0 - c));
+    memcpy(t, &lo, 8);
+    memcpy(t + 8, &hi, 8);
+}
+
+// 调整值序列的 SIMD 生成：每个 128 位通道放一个调整值，所有通道同时乘 α^k（k 为通道总数）：
+// 两个 64 位半部各左移 k 位，低半部移出的 k 位进入高半部，高半部移出的 k 位 h 以 h·0x87 = h ^ h<<1 ^ h<<2 ^ h<<7
+// 约简回低半部（h < 2^8，结果不超过 64 位）。写出 tw[0..n) = T·α^0..n-1，t 前进为 T·α^n
+SM4_TARGET("avx512f,avx512bw") static inline __m512i xts_mul_alpha8_avx512(__m512i x) {
+    __m512i h = _mm512_srli_epi64(x, 56);
+    __m512i r = _mm512_bsrli_epi128(h, 8);
+    __m512i red = _mm512_ternarylogic_epi32(r, _mm512_slli_epi64(r, 1), _mm512_slli_epi64(r, 2), 0x96);
+    red = _mm512_xor_si512(red, _mm512_slli_epi64(r, 7));
+    return _mm512_ternarylogic_epi32(_mm512_slli_epi64(x, 8), _mm512_bslli_epi128(h, 8), red, 0x96);
+}
+
+SM4_TARGET("avx512f,avx512bw") static void xts_tweaks_avx512(u8* tw, u8 t[16], size_t n) {
+    size_t i = 0;
+    if (n >= 8) {
+        // 两个 ZMM 共 8 个调整值，每步乘 α^8
+        alignas(64) u8 init[128];
+        for (int k = 0; k < 8; ++k) {
+            memcpy(init + 16 * k, t, 16);
+            xts_mul_alpha(t);
+        }
+        __m512i x0 = _mm512_load_si512((const void*)init), x1 = _mm512_load_si512((const void*)(init + 64));
+        for (; i + 8 <= n; i += 8) {
+            _mm512_storeu_si512((void*)(tw + 16 * i), x0);
+            _mm512_storeu_si512((void*)(tw + 16 * i + 64), x1);
+            x0 = xts_mul_alpha8_avx512(x0);
+            x1 = xts_mul_alpha8_avx512(x1);
+        }
+        _mm_storeu_si128((__m128i*)t, _mm512_castsi512_si128(x0));
+    }
+    for (; i < n; ++i) {
+        memcpy(tw + 16 * i, t, 16);
+        xts_mul_alpha(t);
+    }
+}
+
+SM4_TARGET("avx2") static void xts_tweaks_avx2(u8* tw, u8 t[16], size_t n) {
+    size_t i = 0;
+    if (n >= 4) {
+        // 两个 YMM 共 4 个调整值，每步乘 α^4
+        alignas(32) u8 init[64];
+        for (int k = 0; k < 4; ++k) {
+            memcpy(init + 16 * k, t, 16);
+            xts_mul_alpha(t);
+        }
+        __m256i x[2] = { _mm256_load_si256((const __m256i*)init), _mm256_load_si256((const __m256i*)(init + 32)) };
+        for (; i + 4 <= n; i += 4) {
+            for (int k = 0; k < 2; ++k) {
+                _mm256_storeu_si256((__m256i*)(tw + 16 * i + 32 * k), x[k]);
+                __m256i h = _mm256_srli_epi64(x[k], 60);
+                __m256i r = _mm256_bsrli_epi128(h, 8);
+                r = _mm256_xor_si256(_mm256_xor_si256(r, _mm256_slli_epi64(r, 1)),
+                    _mm256_xor_si256(_mm256_slli_epi64(r, 2), _mm256_slli_epi64(r, 7)));
+                x[k] = _mm256_xor_si256(_mm256_xor_si256(_mm256_slli_epi64(x[k], 4), _mm256_bslli_epi128(h, 8)), r);
+            }
+        }
+        _mm_storeu_si128((__m128i*)t, _mm256_castsi256_si128(x[0]));
+    }
+    for (; i < n; ++i) {
+        memcpy(tw + 16 * i, t, 16);
+        xts_mul_alpha(t);
+    }
+}
+
+static void xts_tweaks(u8* tw, u8 t[16], size_t n) {
+    if ((SM4_DISPATCH.cpu & (SM4_CPU_AVX512F | SM4_CPU_AVX512BW)) == (SM4_CPU_AVX512F | SM4_CPU_AVX512BW))
+        xts_tweaks_avx512(tw, t, n);
+    else if (SM4_DISPATCH.cpu & SM4_CPU_AVX2)
+        xts_tweaks_avx2(tw, t, n);
+    else
+        for (size_t i = 0; i < n; ++i, xts_mul_alpha(t)) memcpy(tw + 16 * i, t, 16);
+}
+
+// nblocks 个整块：每 SM4_MODE_CHUNK 块先生成整段调整值，异或后一次交给多分组内核，再异或回来。
+// rk 为 K1 的加密或解密轮密钥，t 为第一块的调整值，返回时前进到下一块
+static void xts_crypt_blocks(const u8* in, u8* out, size_t nblocks, u8 t[16], const u32 rk[32]) {
+    alignas(64) u8 tw[SM4_MODE_CHUNK * 16], buf[SM4_MODE_CHUNK * 16];
+    while (nblocks) {
+        size_t n = nblocks < SM4_MODE_CHUNK ? nblocks : SM4_MODE_CHUNK;
+        xts_tweaks(tw, t, n);
+        xor_bytes(buf, in, tw, 16 * n);
+        sm4_encrypt_blocks(buf, buf, n, rk);
+        xor_bytes(out, buf, tw, 16 * n);
+        in += 16 * n; out += 16 * n; nblocks -= n;
+    }
+}
+
+static void xts_crypt_block(const u8* in, u8* out, const u8 t[16], const u32 rk[32]) {
+    u8 b[16];
+    xor_block(b, in, t);
+    SM4_DISPATCH.encrypt_block(b, b, rk);
+    xor_block(out, b, t);
+}
+
+// 一个数据单元，tweak 为 16 字节的调整值（通常是小端的扇区号）
+static bool xts_crypt(const Sm4XtsKey& key, bool decrypt, const u8 tweak[16], const u8* in, u8* out, size_t len) {
+    if (len < 16) return false;
+    SM4_DISPATCH.init();
+    const u32* rk = decrypt ? key.rk1_dec : key.rk1;
+    u8 t[16];
+    SM4_DISPATCH.encrypt_block(tweak, t, key.rk2);
+    size_t full = len / 16, r = len % 16;
+    size_t bulk = r ? full - 1 : full;
+    xts_crypt_blocks(in, out, bulk, t, rk);
+    if (r == 0) return true;
+
+    // 密文挪用：最后一个整块与不足一块的尾部。加密时整块用 T_{m-1}，挪用后的块用 T_m；解密顺序相反
+    in += 16 * bulk; out += 16 * bulk;
+    u8 t_last[16], cc[16], pp[16];
+    memcpy(t_last, t, 16);
+    xts_mul_alpha(t_last);
+    xts_crypt_block(in, cc, decrypt ? t_last : t, rk);
+    memcpy(pp, in + 16, r);
+    memcpy(pp + r, cc + r, 16 - r);
+    memcpy(out + 16, cc, r);
+    xts_crypt_block(pp, out, decrypt ? t : t_last, rk);
+    return true;
+}
+
+inline bool sm4_xts_encrypt(const Sm4XtsKey& key, const u8 tweak[16], const u8* in, u8* out, size_t len) {
+    return xts_crypt(key, false, tweak, in, out, len);
+}
+
+inline bool sm4_xts_decrypt(const Sm4XtsKey& key, const u8 tweak[16], const u8* in, u8* out, size_t len) {
+    return xts_crypt(key, true, tweak, in, out, len);
+}
+
+// 多扇区：len 为 sector_size 的整数倍，第 i 个扇区的调整值为小端的 first_sector + i。
+// 各扇区的 T0 每 16 个一组交给多分组内核（K2）加密，之后每个扇区按整块处理，一次调用覆盖整个 I/O 请求
+static bool xts_crypt_sectors(const Sm4XtsKey& key, bool decrypt, u64 first_sector, size_t sector_size,
+    const u8* in, u8* out, size_t len) {
+    if (sector_size < 16 || sector_size % 16 || len % sector_size) return false;
+    SM4_DISPATCH.init();
+    const u32* rk = decrypt ? key.rk1_dec : key.rk1;
+    size_t nsectors = len / sector_size;
+    alignas(64) u8 seeds[16 * 16];
+    for (size_t s = 0; s < nsectors; s += 16) {
+        size_t n = nsectors - s < 16 ? nsectors - s : 16;
+        memset(seeds, 0, 16 * n);
+        for (size_t i = 0; i < n; ++i) {
+            u64 sector = first_sector + s + i;
+            memcpy(seeds + 16 * i, &sector, 8);
+        }
+        sm4_encrypt_blocks(seeds, seeds, n, key.rk2);
+        for (size_t i = 0; i < n; ++i, in += sector_size, out += sector_size)
+            xts_crypt_blocks(in, out, sector_size / 16, seeds + 16 * i, rk);
+    }
+    return true;
+}
+
+inline bool sm4_xts_encrypt_sectors(const Sm4XtsKey& key, u64 first_sector, size_t sector_size, const u8* in, u8* out, size_t len) {
+    return xts_crypt_sectors(key, false, first_sector, sector_size, in, out, len);
+}
+
+inline bool sm4_xts_decrypt_sectors(const Sm4XtsKey& key, u64 first_sector, size_t sector_size, const u8* in, u8* out, size_t len) {
+    return xts_crypt_sectors(key, true, first_sector, sector_size, in, out, len);
+}
+
+// ---------------------------
+// SM4-CMAC（NIST SP 800-38B 的 CMAC 结构，分组密码换为 SM4）。子密钥 L = E_K(0^128)，
+// K1 = L·x，K2 = K1·x（128 位大端左移一位，移出 1 时最低字节异或 0x87）；最后一块为整块时异或 K1，
+// 否则按 10* 填充后异或 K2。CBC 链在一条消息内前后依赖，多条互相独立的消息则把各自的链放进
+// 多分组内核的不同通道，每次内核调用推进每条链一块。
+// ---------------------------
+static inline void cmac_dbl(const u8 in[16], u8 out[16]) {
+    u8 carry = in[0] >> 7;
+    for (int i = 0; i < 15; ++i) out[i] = (u8)((in[i] << 1) | (in[i + 1] >> 7));
+    out[15] = (u8)((in[15] << 1) ^ (0x87 & (0 - carry)));
+}
+
+struct Sm4CmacKey {
+    alignas(64) u32 rk[32];
+    u8 k1[16];
+    u8 k2[16];
+
+    Sm4CmacKey() {}
+    explicit Sm4CmacKey(const u8 key[16]) { init(key); }
+
+    void init(const u8 key[16]) {
+        u32 k[32];
+        sm4_key_expand(key, k);
+        init_rk(k);
+    }
+
+    void init_rk(const u32 key_rk[32]) {
+        SM4_DISPATCH.init();
+        memcpy(rk, key_rk, sizeof(rk));
+        u8 zero[16] = { 0 }, L[16];
+        SM4_DISPATCH.encrypt_block(zero, L, rk);
+        cmac_dbl(L, k1);
+        cmac_dbl(k1, k2);
+    }
+};
+
+// 最后一块（空消息也算一块）：整块异或 K1，不足一块时补 0x80 00.. 后异或 K2，结果异或进链值
+static inline void cmac_last_block(const Sm4CmacKey& key, const u8* p, size_t left, u8 x[16]) {
+    if (left == 16) {
+        for (int i = 0; i < 16; ++i) x[i] ^= p[i] ^ key.k1[i];
+        return;
+    }
+    u8 b[16] = { 0 };
+    if (left) memcpy(b, p, left);
+    b[left] = 0x80;
+    for (int i = 0; i < 16; ++i) x[i] ^= b[i] ^ key.k2[i];
+}
+
+// 单条消息，逐块串行
+inline void sm4_cmac(const Sm4CmacKey& key, const u8* msg, size_t len, u8 mac[16]) {
+    SM4_DISPATCH.init();
+    u8 x[16] = { 0 };
+    for (; len > 16; msg += 16, len -= 16) {
+        xor_block(x, x, msg);
+        SM4_DISPATCH.encrypt_block(x, x, key.rk);
+    }
+    cmac_last_block(key, msg, len, x);
+    SM4_DISPATCH.encrypt_block(x, mac, key.rk);
+}
+
+struct Sm4CmacJob {
+    const u8* msg;
+    size_t len;
+    u8* mac;            // 16 字节
+};
+
+// 同一密钥下的多条消息：通道数取所选内核的宽度 W（4/8/16，比特切片为 64/256），每个通道持有一条
+// 消息的 CBC 链，每轮把各链的下一块异或进链值后整组交给 encrypt_multi；消息做完即写出 MAC 并
+// 接下一条，长短不一的消息也能让通道保持满载。剩余的链不足半组时逐块调用单分组实现，避免一条
+// 长消息拖着整组内核空转。
+inline void sm4_cmac_multi(const Sm4CmacKey& key, const Sm4CmacJob* jobs, size_t njobs) {
+    SM4_DISPATCH.init();
+    const int W = SM4_DISPATCH.multi_blocks;
+    struct Lane { const u8* p; size_t left; u8* mac; bool busy; };
+    Lane lane[256] = {};
+    alignas(64) u8 x[16 * 256];
+    bool last[256];
+    size_t next = 0;
+    for (;;) {
+        int active = 0;
+        for (int i = 0; i < W; ++i) {
+            Lane& l = lane[i];
+            if (!l.busy) {
+                if (next == njobs) continue;
+                const Sm4CmacJob& j = jobs[next++];
+                l = { j.msg, j.len, j.mac, true };
+                memset(x + 16 * i, 0, 16);
+            }
+            last[i] = l.left <= 16;
+            if (last[i]) cmac_last_block(key, l.p, l.left, x + 16 * i);
+            else {
+                xor_block(x + 16 * i, x + 16 * i, l.p);
+                l.p += 16;
+                l.left -= 16;
+            }
+            ++active;
+        }
+        if (active == 0) break;
+        if (2 * active >= W) SM4_DISPATCH.encrypt_multi(x, x, key.rk);
+        else
+            for (int i = 0; i < W; ++i)
+                if (lane[i].busy) SM4_DISPATCH.encrypt_block(x + 16 * i, x + 16 * i, key.rk);
+        for (int i = 0; i < W; ++i) {
+            if (!lane[i].busy || !last[i]) continue;
+            memcpy(lane[i].mac, x + 16 * i, 16);
+            lane[i].busy = false;
+        }
+    }
+}
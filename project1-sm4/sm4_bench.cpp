@@ -0,0 +1,504 @@
+// SM4 基准测试：覆盖全部 SM4 内核、GHASH 内核与各工作模式，消息长度从 16 字节到 64MB。
+// - 输入取自预先填好随机数据的消息池（至少 256KB），每次调用换下一条消息，编译器无法把重复计算
+//   外提或消除，也不会一直加密同一段缓存中的数据；输出写入单独的缓冲区并汇入 volatile 变量；
+// - 每个测量对象先预热，再按时间预算重复若干次试验，每次试验调用 reps 次，用 rdtsc 计周期，
+//   报告每字节周期数（cycles/byte）的中位数、p99 与最小值，以及按中位数换算的 MB/s；
+// - 密钥扩展等每个密钥的准备工作单独按"周期/个"报告，分块吞吐中不含密钥准备；
+// - 结果写入 JSON，--baseline 读入以前的结果逐项比较，超过阈值变慢时返回非零退出码。
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include "sm4_gcm.h"
+#if !defined(_MSC_VER)
+#include <x86intrin.h>
+#endif
+
+using namespace std::chrono;
+
+// ---------------------------
+// 计时：lfence 保证 rdtsc 不会与被测代码乱序重叠。TSC 以标称频率计数，与睿频无关，
+// 因此周期数是"参考周期"，不同机器之间按 TSC 频率换算成时间后再比较
+// ---------------------------
+static inline u64 tsc_begin() {
+    _mm_lfence();
+    u64 t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+static inline u64 tsc_end() {
+    unsigned aux;
+    u64 t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+// 用 steady_clock 标定 TSC 频率（100ms）
+static double calibrate_tsc_hz() {
+    auto w0 = steady_clock::now();
+    u64 t0 = tsc_begin();
+    while (steady_clock::now() - w0 < milliseconds(100)) {}
+    u64 t1 = tsc_end();
+    double s = duration_cast<nanoseconds>(steady_clock::now() - w0).count() / 1e9;
+    return (t1 - t0) / s;
+}
+
+static volatile u8 g_sink;
+// 测量对象在计时中失败的调用次数（如 GCM 解密认证失败），bench_bulk 按（对象, 长度）清零并记录
+static u64 g_failures;
+
+struct BenchOptions {
+    std::vector<size_t> sizes;
+    std::string filter;                 // 只运行名称包含该子串的测量对象
+    std::string json = "sm4_bench.json";
+    std::string baseline;
+    double budget = 0.25;               // 每个（对象, 长度）的试验总时长，秒
+    double threshold = 0.05;            // 与基线比较时视为变化的相对幅度
+    int max_trials = 201;
+};
+
+// 每次试验至少 1M 个 TSC 周期，太短的试验主要测到计时本身
+static const double TRIAL_CYCLES = 1e6;
+static const int MIN_TRIALS = 5;
+static const size_t POOL_BYTES = 256 * 1024;
+
+struct Stats {
+    int trials = 0;
+    u64 reps = 0;
+    double median = 0, p99 = 0, min = 0;
+};
+
+// 预热后按预算做若干次试验：每次试验调用 reps 次 f(i)（i 为递增的调用序号），
+// 样本为每次试验的周期数 / (reps · units)，units 为一次调用处理的字节数或密钥数
+template<typename F>
+static Stats run_trials(F&& f, double units, double tsc_hz, const BenchOptions& opt) {
+    u64 i = 0;
+    // 预热：至少 2 次调用且至少 20ms，顺带估计单次调用的周期数
+    u64 calls = 0, w0 = tsc_begin(), w1;
+    do {
+        f(i++);
+        ++calls;
+        w1 = tsc_end();
+    } while (calls < 2 || (w1 - w0) < 0.02 * tsc_hz);
+    double per_call = (double)(w1 - w0) / calls;
+    u64 reps = per_call >= TRIAL_CYCLES ? 1 : (u64)(TRIAL_CYCLES / per_call) + 1;
+    int trials = (int)(opt.budget * tsc_hz / (per_call * reps));
+    trials = std::max(MIN_TRIALS, std::min(opt.max_trials, trials));
+
+    std::vector<double> v;
+    for (int t = 0; t < trials; ++t) {
+        u64 t0 = tsc_begin();
+        for (u64 r = 0; r < reps; ++r) f(i++);
+        u64 t1 = tsc_end();
+        v.push_back((double)(t1 - t0) / (reps * units));
+    }
+    std::sort(v.begin(), v.end());
+    Stats s;
+    s.trials = trials;
+    s.reps = reps;
+    s.min = v.front();
+    s.median = v[v.size() / 2];
+    size_t k = (size_t)(0.99 * v.size() + 0.999999);
+    s.p99 = v[std::min(v.size(), std::max<size_t>(k, 1)) - 1];
+    return s;
+}
+
+// 消息池：count 条 len 字节的随机消息（总量至少 POOL_BYTES），输出缓冲区与输入分开
+struct MsgPool {
+    size_t len, count;
+    std::vector<u8> in, out;
+
+    explicit MsgPool(size_t len_) : len(len_) {
+        count = len >= POOL_BYTES ? 1 : POOL_BYTES / len;
+        in.resize(len * count);
+        out.resize(len * count);
+        u64 x = 0x9E3779B97F4A7C15ULL ^ len;
+        for (size_t i = 0; i < in.size(); ++i) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            in[i] = (u8)x;
+        }
+    }
+    u8* msg_in(u64 i) { return &in[(size_t)(i % count) * len]; }
+    u8* msg_out(u64 i) { return &out[(size_t)(i % count) * len]; }
+};
+
+struct BulkTarget {
+    std::string name;
+    // 一次调用：加解密 len 字节，in/out 为消息池中第 i 条消息
+    std::function<void(const u8* in, u8* out, size_t len, u64 i)> run;
+    // 可选：在计时前处理消息池（如 GCM 解密先生成密文与标签）
+    std::function<void(MsgPool& pool)> prepare;
+};
+
+struct BulkResult {
+    std::string target;
+    size_t bytes;
+    Stats s;
+    u64 failures;
+};
+
+struct KeyResult {
+    std::string name;
+    Stats s;
+};
+
+static bool match(const BenchOptions& opt, const std::string& name) {
+    return opt.filter.empty() || name.find(opt.filter) != std::string::npos;
+}
+
+static void bench_bulk(const BulkTarget& t, double tsc_hz, const BenchOptions& opt, std::vector<BulkResult>& out) {
+    if (!match(opt, t.name)) return;
+    for (size_t len : opt.sizes) {
+        MsgPool pool(len);
+        if (t.prepare) t.prepare(pool);
+        g_failures = 0;
+        Stats s = run_trials([&](u64 i) { t.run(pool.msg_in(i), pool.msg_out(i), len, i); }, (double)len, tsc_hz, opt);
+        g_sink = g_sink ^ pool.out[0] ^ pool.out[pool.out.size() - 1];
+        out.push_back({ t.name, len, s, g_failures });
+        printf("%-22s %9zu B  中位 %8.2f  p99 %8.2f  最小 %8.2f 周期/字节  %9.2f MB/s  (%d 次 x %llu)\n",
+            t.name.c_str(), len, s.median, s.p99, s.min, tsc_hz / s.median / (1024 * 1024), s.trials,
+            (unsigned long long)s.reps);
+        if (g_failures) printf("%-22s %9zu B  其中 %llu 次调用失败，以上结果无效\n", t.name.c_str(), len, (unsigned long long)g_failures);
+        fflush(stdout);
+    }
+}
+
+// ---------------------------
+// 测量对象
+// ---------------------------
+static const u8 BENCH_KEY[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
+
+static std::vector<BulkTarget> mode_targets() {
+    // 密钥与密钥上下文在计时之外准备好，静态对象在整个程序运行期间有效
+    static u32 rk[32], rk_dec[32];
+    static Sm4GcmKey gkey;
+    static Sm4XtsKey xkey;
+    static Sm4CmacKey ckey;
+    static std::vector<u8> gcm_tags;
+    sm4_key_expand(BENCH_KEY, rk);
+    sm4_key_expand_dec(BENCH_KEY, rk_dec);
+    gkey.init(BENCH_KEY);
+    ckey.init(BENCH_KEY);
+    u8 xk[32];
+    for (int i = 0; i < 32; ++i) xk[i] = (u8)(i * 37 + 11);
+    xkey.init(xk);
+
+    // 每条消息各自的 IV/计数器：消息序号写入后 8 字节
+    auto iv_of = [](u64 i, u8 iv[16]) {
+        memset(iv, 0x5C, 8);
+        for (int b = 0; b < 8; ++b) iv[8 + b] = (u8)(i >> (56 - 8 * b));
+    };
+    static const u8 aad[13] = { 0 };
+
+    std::vector<BulkTarget> v;
+    v.push_back({ "ecb-enc", [](const u8* in, u8* out, size_t len, u64) { sm4_ecb_encrypt(in, out, len, rk); }, nullptr });
+    v.push_back({ "ecb-dec", [](const u8* in, u8* out, size_t len, u64) { sm4_ecb_decrypt(in, out, len, rk_dec); }, nullptr });
+    v.push_back({ "cbc-enc", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_cbc_encrypt(iv, in, out, len, rk); }, nullptr });
+    v.push_back({ "cbc-dec", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_cbc_decrypt(iv, in, out, len, rk_dec); }, nullptr });
+    v.push_back({ "cfb-enc", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_cfb_encrypt(iv, in, out, len, rk); }, nullptr });
+    v.push_back({ "cfb-dec", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_cfb_decrypt(iv, in, out, len, rk); }, nullptr });
+    v.push_back({ "ofb", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_ofb_crypt(iv, in, out, len, rk); }, nullptr });
+    v.push_back({ "ctr", [=](const u8* in, u8* out, size_t len, u64 i) { u8 iv[16]; iv_of(i, iv); sm4_ctr_crypt(iv, in, out, len, rk); }, nullptr });
+    v.push_back({ "xts-enc", [=](const u8* in, u8* out, size_t len, u64 i) { u8 tw[16]; iv_of(i, tw); sm4_xts_encrypt(xkey, tw, in, out, len); }, nullptr });
+    v.push_back({ "xts-dec", [=](const u8* in, u8* out, size_t len, u64 i) { u8 tw[16]; iv_of(i, tw); sm4_xts_decrypt(xkey, tw, in, out, len); }, nullptr });
+    v.push_back({ "cmac", [](const u8* in, u8*, size_t len, u64) { u8 mac[16]; sm4_cmac(ckey, in, len, mac); g_sink = g_sink ^ mac[0]; }, nullptr });
+    v.push_back({ "gcm-enc", [=](const u8* in, u8* out, size_t len, u64 i) {
+        u8 iv[16], tag[16];
+        iv_of(i, iv);
+        sm4_gcm_encrypt(gkey, iv + 4, in, len, aad, sizeof(aad), out, tag);
+    }, nullptr });
+    // 解密的输入是真实密文与标签：第 i 次调用解密消息 i % count，IV 与标签都取该消息加密时所用的，
+    // 每次都走认证成功的路径；失败计入 g_failures 并在结果中报告
+    v.push_back({ "gcm-dec", [=](const u8* in, u8* out, size_t len, u64 i) {
+        u8 iv[16];
+        size_t m = (size_t)(i % (gcm_tags.size() / 16));
+        iv_of(m, iv);
+        if (!sm4_gcm_decrypt(gkey, iv + 4, in, len, aad, sizeof(aad), &gcm_tags[16 * m], out)) ++g_failures;
+    }, [=](MsgPool& pool) {
+        gcm_tags.assign(16 * pool.count, 0);
+        for (size_t m = 0; m < pool.count; ++m) {
+            u8 iv[16];
+            iv_of(m, iv);
+            sm4_gcm_encrypt(gkey, iv + 4, pool.msg_in(m), pool.len, aad, sizeof(aad), pool.msg_in(m), &gcm_tags[16 * m]);
+        }
+    } });
+    // 一次性接口：每条消息都重新扩展密钥、计算 H，与 gcm-enc 之差即每条消息的密钥准备开销
+    v.push_back({ "gcm-enc-oneshot", [=](const u8* in, u8* out, size_t len, u64 i) {
+        u8 iv[16], tag[16];
+        iv_of(i, iv);
+        sm4_gcm_encrypt(BENCH_KEY, iv + 4, in, len, aad, sizeof(aad), out, tag);
+    }, nullptr });
+    return v;
+}
+
+// 所选 SM4 内核对第 0 条消息的输出与基础实现逐块比对
+static bool kernel_output_ok(size_t len) {
+    u32 rk[32];
+    sm4_key_expand(BENCH_KEY, rk);
+    MsgPool pool(len);
+    std::vector<u8> ref(len);
+    sm4_encrypt_blocks(pool.msg_in(0), pool.msg_out(0), len / 16, rk);
+    for (size_t b = 0; b < len; b += 16) sm4_encrypt_block(pool.msg_in(0) + b, &ref[b], rk);
+    return memcmp(ref.data(), pool.msg_out(0), len) == 0;
+}
+
+static void bench_keys(double tsc_hz, const BenchOptions& opt, std::vector<KeyResult>& out) {
+    const size_t NK = 4096;
+    std::vector<u8> keys(16 * NK);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (u8)(i * 167 + (i >> 8) * 13);
+    static u32 rk[8][32], rk_dec[8][32];
+    static Sm4GcmKey gkey;
+    static Sm4XtsKey xkey;
+    static Sm4CmacKey ckey;
+
+    struct KeyTarget { const char* name; double per_call; std::function<void(u64)> run; };
+    std::vector<KeyTarget> v = {
+        { "key_expand", 1, [&](u64 i) { sm4_key_expand(&keys[16 * (i % NK)], rk[0]); } },
+        { "key_expand_dec", 1, [&](u64 i) { sm4_key_expand_dec(&keys[16 * (i % NK)], rk_dec[0]); } },
+        { "key_expand_batch8", 8, [&](u64 i) { sm4_key_expand_batch(&keys[16 * (8 * i % NK)], 8, rk, rk_dec); } },
+        { "gcm_key_init", 1, [&](u64 i) { gkey.init(&keys[16 * (i % NK)]); } },
+        { "xts_key_init", 1, [&](u64 i) { xkey.init(&keys[16 * (2 * i % NK)]); } },
+        { "cmac_key_init", 1, [&](u64 i) { ckey.init(&keys[16 * (i % NK)]); } },
+    };
+    for (const KeyTarget& t : v) {
+        if (!match(opt, t.name)) continue;
+        Stats s = run_trials(t.run, t.per_call, tsc_hz, opt);
+        g_sink = g_sink ^ (u8)rk[0][0] ^ (u8)gkey.rk[31];
+        out.push_back({ t.name, s });
+        printf("%-22s 中位 %8.1f  p99 %8.1f  最小 %8.1f 周期/个  %9.0f 个/秒\n",
+            t.name, s.median, s.p99, s.min, tsc_hz / s.median);
+    }
+}
+
+// ---------------------------
+// JSON 输出与基线比较：每个结果单独一行，便于逐行解析与 diff
+// ---------------------------
+static std::string json_escape(const char* s) {
+    std::string r;
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') r += '\\';
+        r += *s;
+    }
+    return r;
+}
+
+static std::string cpu_feature_names(u32 cpu) {
+    static const struct { u32 bit; const char* name; } F[] = {
+        { SM4_CPU_SSSE3, "ssse3" }, { SM4_CPU_SSE41, "sse4.1" }, { SM4_CPU_AESNI, "aes" }, { SM4_CPU_PCLMUL, "pclmul" },
+        { SM4_CPU_AVX2, "avx2" }, { SM4_CPU_AVX512F, "avx512f" }, { SM4_CPU_AVX512BW, "avx512bw" },
+        { SM4_CPU_GFNI, "gfni" }, { SM4_CPU_VPCLMUL, "vpclmulqdq" },
+    };
+    std::string r;
+    for (auto& f : F) if (cpu & f.bit) r += std::string(r.empty() ? "" : " ") + f.name;
+    return r;
+}
+
+static bool write_json(const std::string& path, double tsc_hz, const std::vector<KeyResult>& keys,
+    const std::vector<BulkResult>& bulk, const std::vector<std::pair<std::string, bool>>& checks) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+#if defined(__VERSION__)
+    const char* compiler = __VERSION__;
+#else
+    const char* compiler = "unknown";
+#endif
+    fprintf(f, "{\n  \"schema\": 1,\n  \"unix_time\": %lld,\n  \"compiler\": \"%s\",\n",
+        (long long)duration_cast<seconds>(system_clock::now().time_since_epoch()).count(), json_escape(compiler).c_str());
+    fprintf(f, "  \"cpu_features\": \"%s\",\n  \"sm4_kernel\": \"%s\",\n  \"ghash_kernel\": \"%s\",\n  \"tsc_hz\": %.0f,\n",
+        cpu_feature_names(SM4_DISPATCH.cpu).c_str(), SM4_DISPATCH.kernel->name, GHASH_DISPATCH.kernel->name, tsc_hz);
+    fprintf(f, "  \"kernel_checks\": [\n");
+    for (size_t i = 0; i < checks.size(); ++i)
+        fprintf(f, "    {\"kernel\": \"%s\", \"ok\": %s}%s\n", checks[i].first.c_str(), checks[i].second ? "true" : "false",
+            i + 1 < checks.size() ? "," : "");
+    fprintf(f, "  ],\n  \"key_setup\": [\n");
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const Stats& s = keys[i].s;
+        fprintf(f, "    {\"name\": \"%s\", \"trials\": %d, \"reps\": %llu, \"cycles_median\": %.2f, \"cycles_p99\": %.2f, "
+            "\"cycles_min\": %.2f, \"keys_per_s\": %.0f}%s\n", keys[i].name.c_str(), s.trials, (unsigned long long)s.reps,
+            s.median, s.p99, s.min, tsc_hz / s.median, i + 1 < keys.size() ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"bulk\": [\n");
+    for (size_t i = 0; i < bulk.size(); ++i) {
+        const Stats& s = bulk[i].s;
+        fprintf(f, "    {\"target\": \"%s\", \"bytes\": %zu, \"trials\": %d, \"reps\": %llu, \"cpb_median\": %.4f, "
+            "\"cpb_p99\": %.4f, \"cpb_min\": %.4f, \"mb_per_s\": %.2f, \"failures\": %llu}%s\n", bulk[i].target.c_str(), bulk[i].bytes, s.trials,
+            (unsigned long long)s.reps, s.median, s.p99, s.min, tsc_hz / s.median / (1024 * 1024),
+            (unsigned long long)bulk[i].failures, i + 1 < bulk.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// 从一行 JSON 中取 "key": 后面的字符串或数值
+static bool json_field(const char* line, const char* key, std::string* str, double* num) {
+    std::string pat = std::string("\"") + key + "\": ";
+    const char* p = strstr(line, pat.c_str());
+    if (!p) return false;
+    p += pat.size();
+    if (str) {
+        if (*p != '"') return false;
+        const char* e = strchr(p + 1, '"');
+        if (!e) return false;
+        str->assign(p + 1, e);
+        return true;
+    }
+    return sscanf(p, "%lf", num) == 1;
+}
+
+// 与基线逐项比较中位数（周期/字节、周期/个），返回变慢超过阈值的项数；找不到基线文件时返回 -1
+static int compare_baseline(const BenchOptions& opt, const std::vector<KeyResult>& keys, const std::vector<BulkResult>& bulk) {
+    FILE* f = fopen(opt.baseline.c_str(), "r");
+    if (!f) return -1;
+    int slower = 0, faster = 0, matched = 0;
+    char line[1024];
+    printf("\n与基线 %s 比较（中位数变化超过 %.0f%%）:\n", opt.baseline.c_str(), 100 * opt.threshold);
+    while (fgets(line, sizeof(line), f)) {
+        std::string name;
+        double bytes = 0, old_v = 0, new_v = 0;
+        bool found = false;
+        if (json_field(line, "target", &name, nullptr) && json_field(line, "bytes", nullptr, &bytes) &&
+            json_field(line, "cpb_median", nullptr, &old_v)) {
+            for (const BulkResult& r : bulk)
+                if (r.target == name && (double)r.bytes == bytes) { new_v = r.s.median; found = true; }
+            name += " " + std::to_string((size_t)bytes) + " B";
+        } else if (json_field(line, "name", &name, nullptr) && json_field(line, "cycles_median", nullptr, &old_v)) {
+            for (const KeyResult& r : keys)
+                if (r.name == name) { new_v = r.s.median; found = true; }
+        }
+        if (!found || old_v <= 0) continue;
+        ++matched;
+        double ratio = new_v / old_v;
+        if (ratio > 1 + opt.threshold) ++slower;
+        else if (ratio < 1 - opt.threshold) ++faster;
+        else continue;
+        printf("  %-32s %10.3f -> %10.3f  (%+.1f%%) %s\n", name.c_str(), old_v, new_v, 100 * (ratio - 1),
+            ratio > 1 ? "变慢" : "变快");
+    }
+    fclose(f);
+    printf("共比较 %d 项：变慢 %d 项，变快 %d 项\n", matched, slower, faster);
+    return slower;
+}
+
+// ---------------------------
+// 命令行
+// ---------------------------
+static void usage() {
+    printf("用法: sm4_bench [选项]\n");
+    printf("  --sizes a,b,...   消息长度（字节，须为 16 的倍数），默认 16 到 64MB 每次乘 4\n");
+    printf("  --max-size N      只测不超过 N 字节的长度\n");
+    printf("  --quick           长度只到 1MB，每项预算 0.05 秒\n");
+    printf("  --filter S        只运行名称包含 S 的测量对象（如 kernel/、gcm、key_expand）\n");
+    printf("  --budget SEC      每个（对象, 长度）的试验总时长，默认 0.25\n");
+    printf("  --json PATH       结果文件，默认 sm4_bench.json\n");
+    printf("  --baseline PATH   与以前的结果比较，变慢超过阈值时退出码为 3\n");
+    printf("  --threshold R     比较阈值（相对值），默认 0.05\n");
+}
+
+static bool parse_args(int argc, char** argv, BenchOptions& opt) {
+    size_t max_size = 64u << 20;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has = i + 1 < argc;
+        if (a == "--quick") { max_size = std::min<size_t>(max_size, 1u << 20); opt.budget = 0.05; }
+        else if (a == "--sizes" && has) {
+            std::string s = argv[++i];
+            for (size_t p = 0; p < s.size();) {
+                size_t e = s.find(',', p);
+                if (e == std::string::npos) e = s.size();
+                size_t n = strtoull(s.substr(p, e - p).c_str(), nullptr, 10);
+                if (n == 0 || n % 16) return false;
+                opt.sizes.push_back(n);
+                p = e + 1;
+            }
+        }
+        else if (a == "--max-size" && has) max_size = strtoull(argv[++i], nullptr, 10);
+        else if (a == "--filter" && has) opt.filter = argv[++i];
+        else if (a == "--budget" && has) opt.budget = atof(argv[++i]);
+        else if (a == "--json" && has) opt.json = argv[++i];
+        else if (a == "--baseline" && has) opt.baseline = argv[++i];
+        else if (a == "--threshold" && has) opt.threshold = atof(argv[++i]);
+        else return false;
+    }
+    if (opt.sizes.empty())
+        for (size_t n = 16; n <= (64u << 20); n *= 4) opt.sizes.push_back(n);
+    opt.sizes.erase(std::remove_if(opt.sizes.begin(), opt.sizes.end(), [&](size_t n) { return n > max_size; }), opt.sizes.end());
+    return !opt.sizes.empty() && opt.budget > 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+    if (!SM4_DISPATCH.init()) {
+        printf("S盒查找表构造失败\n");
+        return 1;
+    }
+    GHASH_DISPATCH.init();
+    const Sm4KernelInfo* selected = SM4_DISPATCH.kernel;
+    const GhashKernelInfo* selected_ghash = GHASH_DISPATCH.kernel;
+    double tsc_hz = calibrate_tsc_hz();
+    printf("CPU 特性: %s\n自动选择: SM4 %s，GHASH %s；TSC %.3f GHz\n\n", cpu_feature_names(SM4_DISPATCH.cpu).c_str(),
+        selected->name, selected_ghash->name, tsc_hz / 1e9);
+
+    std::vector<KeyResult> keys;
+    std::vector<BulkResult> bulk;
+    std::vector<std::pair<std::string, bool>> checks;
+
+    printf("密钥准备（每个密钥）:\n");
+    bench_keys(tsc_hz, opt, keys);
+
+    // 各 SM4 内核：强制选中后经 sm4_encrypt_blocks 加密整条消息（不足一组的尾部与实际调用一样逐块处理）
+    printf("\nSM4 内核:\n");
+    u32 rk[32];
+    sm4_key_expand(BENCH_KEY, rk);
+    for (int k = 0; k < SM4_KERNEL_COUNT; ++k) {
+        const Sm4KernelInfo& info = SM4_KERNELS[k];
+        if (!SM4_DISPATCH.supported(info)) continue;
+        std::string name = std::string("kernel/") + info.name;
+        if (!match(opt, name)) continue;
+        SM4_DISPATCH.select(info.name);
+        checks.push_back({ info.name, kernel_output_ok(4096) });
+        bench_bulk({ name, [&](const u8* in, u8* out, size_t len, u64) { sm4_encrypt_blocks(in, out, len / 16, rk); }, nullptr },
+            tsc_hz, opt, bulk);
+    }
+    SM4_DISPATCH.select(selected->name);
+
+    printf("\nGHASH 内核:\n");
+    u8 hb[16];
+    sm4_encrypt_block(std::vector<u8>(16, 0).data(), hb, rk);
+    static GhashKey gk;
+    ghash_key_init(gk, load_be128(hb), GHASH_TABLE4 | GHASH_TABLE8);
+    for (const GhashKernelInfo& k : GHASH_KERNELS) {
+        if ((SM4_DISPATCH.cpu & k.need) != k.need) continue;
+        ghash_blocks_fn fn = k.blocks;
+        u128 X{ 0, 0 };
+        bench_bulk({ std::string("ghash/") + k.name, [fn, &X](const u8* in, u8*, size_t len, u64) { fn(X, in, len / 16, gk); }, nullptr },
+            tsc_hz, opt, bulk);
+        g_sink = g_sink ^ (u8)X.lo;
+    }
+
+    printf("\n工作模式（SM4 %s，GHASH %s）:\n", selected->name, selected_ghash->name);
+    for (const BulkTarget& t : mode_targets()) bench_bulk(t, tsc_hz, opt, bulk);
+
+    bool all_ok = true;
+    for (auto& c : checks) {
+        if (!c.second) printf("内核 %s 输出与基础实现不一致\n", c.first.c_str());
+        all_ok = all_ok && c.second;
+    }
+    for (auto& b : bulk) {
+        if (b.failures) printf("%s %zu B: %llu 次调用失败\n", b.target.c_str(), b.bytes, (unsigned long long)b.failures);
+        all_ok = all_ok && b.failures == 0;
+    }
+    if (write_json(opt.json, tsc_hz, keys, bulk, checks)) printf("\n结果已写入 %s\n", opt.json.c_str());
+    else printf("\n无法写入 %s\n", opt.json.c_str());
+    if (!opt.baseline.empty()) {
+        int slower = compare_baseline(opt, keys, bulk);
+        if (slower < 0) printf("无法读取基线 %s\n", opt.baseline.c_str());
+        else if (slower > 0) return 3;
+    }
+    return all_ok ? 0 : 2;
+}
@@ -0,0 +1,384 @@
+// 分块文件加密：把任意大小的文件切成固定大小的块，每块单独用 SM4-GCM 封装，不需要把整个文件读入内存，
+// 任意一块都可以单独解密（随机访问）。容器格式（整数均为大端）：
+//
+//   文件头（32 字节）  magic "SM4GCMF\0" | 版本 u32 | 块大小 u32 | 随机 nonce 基值 12 字节 | 保留 4 字节
+//   第 i 块            密文（块大小，最后一块可以更短）| 标签 16 字节，起始偏移 32 + i·(块大小 + 16)
+//   块索引            每块 12 字节：块起始偏移 u64 | 明文长度 u32
+//   尾部（48 字节）    块数 u64 | 明文总长 u64 | 索引偏移 u64 | magic "SM4GCMT\0" | 标签 16 字节
+//
+// 第 i 块的 IV 为 nonce 基值的后 8 字节异或 i，AAD 为文件头 || i（u64），块不能在文件之间或文件内调换位置。
+// 尾部标签是以 i = 2^64 - 1 为 IV、文件头 || 索引 || 尾部前 32 字节为 AAD 的 GMAC（明文为空），
+// 认证块数与总长，截断或删除整块都会被发现。
+#pragma once
+#include "sm4_gcm.h"
+#include "sm4_parallel.h"
+#include <atomic>
+#include <random>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+static const u32 SM4_FILE_VERSION = 1;
+static const size_t SM4_FILE_HEADER = 32;
+static const size_t SM4_FILE_TRAILER = 48;
+static const size_t SM4_FILE_INDEX_ENTRY = 12;
+static const u32 SM4_FILE_DEFAULT_CHUNK = 1u << 20;
+static const u32 SM4_FILE_MAX_CHUNK = 1u << 30;
+static const char SM4_FILE_MAGIC[8] = { 'S', 'M', '4', 'G', 'C', 'M', 'F', 0 };
+static const char SM4_FILE_TRAILER_MAGIC[8] = { 'S', 'M', '4', 'G', 'C', 'M', 'T', 0 };
+
+static inline void store_be64(u8* p, u64 v) {
+    for (int b = 0; b < 8; ++b) p[b] = (u8)(v >> (56 - 8 * b));
+}
+static inline u64 load_be64(const u8* p) {
+    u64 v = 0;
+    for (int b = 0; b < 8; ++b) v = (v << 8) | p[b];
+    return v;
+}
+static inline void store_be32(u8* p, u32 v) {
+    for (int b = 0; b < 4; ++b) p[b] = (u8)(v >> (24 - 8 * b));
+}
+
+// ---------------------------
+// 按偏移读写的文件句柄：多个工作线程可以同时对同一句柄 pread/pwrite，互不影响
+// ---------------------------
+struct Sm4File {
+#if defined(_WIN32)
+    HANDLE h = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+    Sm4File() {}
+    Sm4File(const Sm4File&) = delete;
+    Sm4File& operator=(const Sm4File&) = delete;
+    ~Sm4File() { close(); }
+
+    // write 为 true 时创建或清空后以读写方式打开
+    bool open(const char* path, bool write) {
+        close();
+#if defined(_WIN32)
+        h = CreateFileA(path, write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, nullptr,
+            write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return h != INVALID_HANDLE_VALUE;
+#else
+        fd = write ? ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0600) : ::open(path, O_RDONLY);
+        return fd >= 0;
+#endif
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+        h = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    bool size(u64* out) const {
+#if defined(_WIN32)
+        LARGE_INTEGER s;
+        if (!GetFileSizeEx(h, &s)) return false;
+        *out = (u64)s.QuadPart;
+#else
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        *out = (u64)st.st_size;
+#endif
+        return true;
+    }
+
+    bool resize(u64 len) {
+#if defined(_WIN32)
+        LARGE_INTEGER pos;
+        pos.QuadPart = (LONGLONG)len;
+        return SetFilePointerEx(h, pos, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+#else
+        return ftruncate(fd, (off_t)len) == 0;
+#endif
+    }
+
+    // 读满 len 字节，遇到文件尾或出错返回 false
+    bool read_at(void* buf, size_t len, u64 off) const {
+        u8* p = (u8*)buf;
+        while (len) {
+            size_t want = len < (1u << 30) ? len : (1u << 30);
+#if defined(_WIN32)
+            OVERLAPPED ov = {};
+            ov.Offset = (DWORD)off;
+            ov.OffsetHigh = (DWORD)(off >> 32);
+            DWORD got = 0;
+            if (!ReadFile(h, p, (DWORD)want, &got, &ov) || got == 0) return false;
+#else
+            ssize_t got = ::pread(fd, p, want, (off_t)off);
+            if (got <= 0) return false;
+#endif
+            p += got; off += (u64)got; len -= (size_t)got;
+        }
+        return true;
+    }
+
+    bool write_at(const void* buf, size_t len, u64 off) const {
+        const u8* p = (const u8*)buf;
+        while (len) {
+            size_t want = len < (1u << 30) ? len : (1u << 30);
+#if defined(_WIN32)
+            OVERLAPPED ov = {};
+            ov.Offset = (DWORD)off;
+            ov.OffsetHigh = (DWORD)(off >> 32);
+            DWORD put = 0;
+            if (!WriteFile(h, p, (DWORD)want, &put, &ov) || put == 0) return false;
+#else
+            ssize_t put = ::pwrite(fd, p, want, (off_t)off);
+            if (put <= 0) return false;
+#endif
+            p += put; off += (u64)put; len -= (size_t)put;
+        }
+        return true;
+    }
+};
+
+// ---------------------------
+// 文件头、IV 与 AAD
+// ---------------------------
+struct Sm4FileHeader {
+    u32 chunk_size;
+    u8 nonce[12];
+
+    void encode(u8 out[SM4_FILE_HEADER]) const {
+        memset(out, 0, SM4_FILE_HEADER);
+        memcpy(out, SM4_FILE_MAGIC, 8);
+        store_be32(out + 8, SM4_FILE_VERSION);
+        store_be32(out + 12, chunk_size);
+        memcpy(out + 16, nonce, 12);
+    }
+
+    bool decode(const u8 in[SM4_FILE_HEADER]) {
+        if (memcmp(in, SM4_FILE_MAGIC, 8) != 0 || load_be32(in + 8) != SM4_FILE_VERSION) return false;
+        chunk_size = load_be32(in + 12);
+        memcpy(nonce, in + 16, 12);
+        return chunk_size != 0 && chunk_size <= SM4_FILE_MAX_CHUNK;
+    }
+};
+
+static void sm4_file_iv(const u8 nonce[12], u64 index, u8 iv[12]) {
+    memcpy(iv, nonce, 12);
+    for (int b = 0; b < 8; ++b) iv[4 + b] ^= (u8)(index >> (56 - 8 * b));
+}
+
+static void sm4_file_chunk_aad(const u8 header[SM4_FILE_HEADER], u64 index, u8 aad[SM4_FILE_HEADER + 8]) {
+    memcpy(aad, header, SM4_FILE_HEADER);
+    store_be64(aad + SM4_FILE_HEADER, index);
+}
+
+// 尾部标签：AAD 为文件头 || 索引 || 尾部前 32 字节，明文为空
+static void sm4_file_trailer_tag(const Sm4GcmKey& gkey, const u8 header[SM4_FILE_HEADER], const u8 nonce[12],
+    const u8* index, size_t index_len, const u8 trailer[32], u8 tag[16]) {
+    u8 iv[12];
+    sm4_file_iv(nonce, ~(u64)0, iv);
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv);
+    ctx.update_aad(header, SM4_FILE_HEADER);
+    ctx.update_aad(index, index_len);
+    ctx.update_aad(trailer, 32);
+    ctx.final(tag);
+}
+
+static inline u64 sm4_file_chunk_offset(u64 i, u32 chunk_size) {
+    return SM4_FILE_HEADER + i * ((u64)chunk_size + 16);
+}
+
+// ---------------------------
+// 并行流水线：工作线程各自领取下一块，读入（大块 pread）-> 加解密 -> 按固定偏移写出。
+// 各线程处于不同阶段，一个线程等待磁盘时其他线程在计算，磁盘与各核同时忙碌；每个线程只占
+// 两块缓冲区，内存占用与文件大小无关。输出偏移由块号直接算出，完成顺序不影响结果。
+// ---------------------------
+struct Sm4FileStats {
+    u64 bytes = 0;      // 明文字节数
+    u64 chunks = 0;
+};
+
+// 加密 in_path 到 out_path，chunk_size 为每块明文字节数。出错时返回 false，err 为原因
+inline bool sm4_file_encrypt(Sm4ThreadPool& pool, const u8 key[16], const char* in_path, const char* out_path,
+    u32 chunk_size = SM4_FILE_DEFAULT_CHUNK, Sm4FileStats* stats = nullptr, const char** err = nullptr) {
+    const char* dummy;
+    if (!err) err = &dummy;
+    if (chunk_size == 0 || chunk_size > SM4_FILE_MAX_CHUNK) { *err = "块大小无效"; return false; }
+    Sm4File in, out;
+    u64 total;
+    if (!in.open(in_path, false) || !in.size(&total)) { *err = "无法打开输入文件"; return false; }
+    if (!out.open(out_path, true)) { *err = "无法创建输出文件"; return false; }
+
+    Sm4FileHeader fh;
+    fh.chunk_size = chunk_size;
+    std::random_device rd;
+    for (int i = 0; i < 12; i += 4) store_be32(fh.nonce + i, (u32)rd());
+    u8 header[SM4_FILE_HEADER];
+    fh.encode(header);
+    Sm4GcmKey gkey(key);
+
+    const u64 nchunks = (total + chunk_size - 1) / chunk_size;
+    const u64 index_off = SM4_FILE_HEADER + total + 16 * nchunks;
+    std::vector<u8> index((size_t)nchunks * SM4_FILE_INDEX_ENTRY);
+    for (u64 i = 0; i < nchunks; ++i) {
+        u64 len = total - i * chunk_size < chunk_size ? total - i * chunk_size : chunk_size;
+        store_be64(&index[(size_t)i * SM4_FILE_INDEX_ENTRY], sm4_file_chunk_offset(i, chunk_size));
+        store_be32(&index[(size_t)i * SM4_FILE_INDEX_ENTRY + 8], (u32)len);
+    }
+    if (!out.resize(index_off + index.size() + SM4_FILE_TRAILER) || !out.write_at(header, SM4_FILE_HEADER, 0)) {
+        *err = "写输出文件失败";
+        return false;
+    }
+
+    std::atomic<u64> next(0);
+    std::atomic<bool> failed(false);
+    std::function<void(unsigned)> fn = [&](unsigned) {
+        std::vector<u8> pt(chunk_size), ct(chunk_size + 16);
+        u8 iv[12], aad[SM4_FILE_HEADER + 8];
+        for (u64 i; !failed && (i = next++) < nchunks;) {
+            size_t len = (size_t)(total - i * chunk_size < chunk_size ? total - i * chunk_size : chunk_size);
+            if (!in.read_at(pt.data(), len, i * chunk_size)) { failed = true; break; }
+            sm4_file_iv(fh.nonce, i, iv);
+            sm4_file_chunk_aad(header, i, aad);
+            sm4_gcm_encrypt(gkey, iv, pt.data(), len, aad, sizeof(aad), ct.data(), ct.data() + len);
+            if (!out.write_at(ct.data(), len + 16, sm4_file_chunk_offset(i, chunk_size))) { failed = true; break; }
+        }
+        gcm_secure_zero(pt.data(), pt.size());
+    };
+    pool.run(fn);
+    if (failed) { *err = "读写文件失败"; return false; }
+
+    u8 trailer[SM4_FILE_TRAILER];
+    store_be64(trailer, nchunks);
+    store_be64(trailer + 8, total);
+    store_be64(trailer + 16, index_off);
+    memcpy(trailer + 24, SM4_FILE_TRAILER_MAGIC, 8);
+    sm4_file_trailer_tag(gkey, header, fh.nonce, index.data(), index.size(), trailer, trailer + 32);
+    if (!out.write_at(index.data(), index.size(), index_off) ||
+        !out.write_at(trailer, SM4_FILE_TRAILER, index_off + index.size())) {
+        *err = "写输出文件失败";
+        return false;
+    }
+    if (stats) { stats->bytes = total; stats->chunks = nchunks; }
+    return true;
+}
+
+// ---------------------------
+// 随机访问：打开时校验文件头、尾部标签与索引，之后任意一块都可以单独读取并认证
+// ---------------------------
+struct Sm4FileReader {
+    Sm4File file;
+    Sm4GcmKey gkey;
+    Sm4FileHeader fh;
+    u8 header[SM4_FILE_HEADER];
+    u64 nchunks = 0, total = 0;
+    std::vector<u8> index;
+
+    bool open(const u8 key[16], const char* path, const char** err = nullptr) {
+        const char* dummy;
+        if (!err) err = &dummy;
+        u64 fsize;
+        if (!file.open(path, false) || !file.size(&fsize)) { *err = "无法打开输入文件"; return false; }
+        if (fsize < SM4_FILE_HEADER + SM4_FILE_TRAILER || !file.read_at(header, SM4_FILE_HEADER, 0) || !fh.decode(header)) {
+            *err = "不是 SM4 分块加密文件";
+            return false;
+        }
+        u8 trailer[SM4_FILE_TRAILER];
+        if (!file.read_at(trailer, SM4_FILE_TRAILER, fsize - SM4_FILE_TRAILER) ||
+            memcmp(trailer + 24, SM4_FILE_TRAILER_MAGIC, 8) != 0) {
+            *err = "文件尾部缺失或已截断";
+            return false;
+        }
+        nchunks = load_be64(trailer);
+        total = load_be64(trailer + 8);
+        u64 index_off = load_be64(trailer + 16);
+        // 块数、总长与索引位置必须与文件大小吻合，再读索引
+        u64 expect_chunks = (total + fh.chunk_size - 1) / fh.chunk_size;
+        if (nchunks != expect_chunks || nchunks > (fsize - SM4_FILE_TRAILER) / SM4_FILE_INDEX_ENTRY ||
+            index_off != fsize - SM4_FILE_TRAILER - nchunks * SM4_FILE_INDEX_ENTRY ||
+            index_off != SM4_FILE_HEADER + total + 16 * nchunks) {
+            *err = "文件结构不一致";
+            return false;
+        }
+        index.resize((size_t)nchunks * SM4_FILE_INDEX_ENTRY);
+        if (!file.read_at(index.data(), index.size(), index_off)) { *err = "读取索引失败"; return false; }
+        gkey.init(key);
+        u8 tag[16];
+        sm4_file_trailer_tag(gkey, header, fh.nonce, index.data(), index.size(), trailer, tag);
+        if (!gcm_tag_equal(tag, trailer + 32, 16)) { *err = "尾部认证失败（密钥错误或文件被篡改）"; return false; }
+        for (u64 i = 0; i < nchunks; ++i) {
+            u64 len = total - i * fh.chunk_size < fh.chunk_size ? total - i * fh.chunk_size : fh.chunk_size;
+            if (chunk_offset(i) != sm4_file_chunk_offset(i, fh.chunk_size) || chunk_len(i) != len) {
+                *err = "块索引不一致";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    u64 chunk_offset(u64 i) const { return load_be64(&index[(size_t)i * SM4_FILE_INDEX_ENTRY]); }
+    size_t chunk_len(u64 i) const { return load_be32(&index[(size_t)i * SM4_FILE_INDEX_ENTRY + 8]); }
+
+    // 解密第 i 块到 out（至少 chunk_len(i) 字节）；buf 为 chunk_len(i) + 16 字节的工作区。
+    // 认证失败时 out 被清零；多个线程可以同时对同一个 reader 调用
+    bool decrypt_chunk(u64 i, u8* out, u8* buf) const {
+        if (i >= nchunks) return false;
+        size_t len = chunk_len(i);
+        if (!file.read_at(buf, len + 16, chunk_offset(i))) return false;
+        u8 iv[12], aad[SM4_FILE_HEADER + 8];
+        sm4_file_iv(fh.nonce, i, iv);
+        sm4_file_chunk_aad(header, i, aad);
+        return sm4_gcm_decrypt(gkey, iv, buf, len, aad, sizeof(aad), buf + len, out);
+    }
+
+    // 读取明文 [offset, offset + len)，只解密涉及的块
+    bool read(u64 offset, u8* out, size_t len) const {
+        if (offset > total || len > total - offset) return false;
+        std::vector<u8> pt(fh.chunk_size), buf((size_t)fh.chunk_size + 16);
+        while (len) {
+            u64 i = offset / fh.chunk_size;
+            size_t skip = (size_t)(offset % fh.chunk_size);
+            if (!decrypt_chunk(i, pt.data(), buf.data())) return false;
+            size_t n = chunk_len(i) - skip < len ? chunk_len(i) - skip : len;
+            memcpy(out, pt.data() + skip, n);
+            out += n; offset += n; len -= n;
+        }
+        gcm_secure_zero(pt.data(), pt.size());
+        return true;
+    }
+};
+
+// 解密整个文件。任何一块认证失败都返回 false，并把输出文件截断为空，不留下未经认证的明文
+inline bool sm4_file_decrypt(Sm4ThreadPool& pool, const u8 key[16], const char* in_path, const char* out_path,
+    Sm4FileStats* stats = nullptr, const char** err = nullptr) {
+    const char* dummy;
+    if (!err) err = &dummy;
+    Sm4FileReader reader;
+    if (!reader.open(key, in_path, err)) return false;
+    Sm4File out;
+    if (!out.open(out_path, true) || !out.resize(reader.total)) { *err = "无法创建输出文件"; return false; }
+
+    const u32 chunk_size = reader.fh.chunk_size;
+    std::atomic<u64> next(0);
+    std::atomic<int> failed(0);     // 1 为读写失败，2 为认证失败
+    std::function<void(unsigned)> fn = [&](unsigned) {
+        std::vector<u8> pt(chunk_size), buf((size_t)chunk_size + 16);
+        for (u64 i; !failed && (i = next++) < reader.nchunks;) {
+            if (!reader.decrypt_chunk(i, pt.data(), buf.data())) { failed = 2; break; }
+            if (!out.write_at(pt.data(), reader.chunk_len(i), i * chunk_size)) { failed = 1; break; }
+        }
+        gcm_secure_zero(pt.data(), pt.size());
+    };
+    pool.run(fn);
+    if (failed) {
+        out.resize(0);
+        *err = failed == 2 ? "块认证失败（文件被篡改）" : "读写文件失败";
+        return false;
+    }
+    if (stats) { stats->bytes = reader.total; stats->chunks = reader.nchunks; }
+    return true;
+}
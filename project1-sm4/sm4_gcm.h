@@ -0,0 +1,1395 @@
+// GHASH 与 SM4-GCM：各 GHASH 内核、拼接的 GCTR + GHASH 循环、密钥上下文、流式与一次性接口、
+// 批处理、分段输入输出、密钥上下文缓存、超长消息的多线程 GCM 与小消息的密钥流预取，
+// 供 sm4-GCM.cpp 与 sm4_file.cpp 共用。
+#pragma once
+#include "sm4.h"
+#include "sm4_multikey.h"
+#include "sm4_parallel.h"
+#include <atomic>
+#include <unordered_map>
+
+// ---------------------------
+// GHASH & SM4-GCM 
+// ---------------------------
+struct u128 { u64 hi; u64 lo; };
+static inline u128 xor128(const u128& a, const u128& b) { return { a.hi ^ b.hi, a.lo ^ b.lo }; }
+// GF(2^128) 乘法（GCM 比特序：hi 的最高位为第 0 位），逐位移位并按 R = 0xE1 || 0^120 约简
+inline u128 gfmul128_slow(u128 X, u128 Y) {
+    u128 Z{ 0,0 };
+    u128 V = Y;
+    for (int i = 0; i < 128; ++i) {
+        u64 bit = (i < 64) ? ((X.hi >> (63 - i)) & 1) : ((X.lo >> (127 - i)) & 1);
+        if (bit) Z = xor128(Z, V);
+        u64 lsb = V.lo & 1;
+        V.lo = (V.lo >> 1) | (V.hi << 63);
+        V.hi >>= 1;
+        if (lsb) V.hi ^= 0xE100000000000000ULL;
+    }
+    return Z;
+}
+static inline u128 load_be128(const u8 block[16]) {
+    u128 B;
+    B.hi = ((u64)block[0] << 56) | ((u64)block[1] << 48) | ((u64)block[2] << 40) | ((u64)block[3] << 32) |
+        ((u64)block[4] << 24) | ((u64)block[5] << 16) | ((u64)block[6] << 8) | ((u64)block[7]);
+    B.lo = ((u64)block[8] << 56) | ((u64)block[9] << 48) | ((u64)block[10] << 40) | ((u64)block[11] << 32) |
+        ((u64)block[12] << 24) | ((u64)block[13] << 16) | ((u64)block[14] << 8) | ((u64)block[15]);
+    return B;
+}
+inline void ghash_update(u128& X, const u8 block[16], const u128& H) {
+    X = xor128(X, load_be128(block));
+    X = gfmul128_slow(X, H);
+}
+
+// 乘以 x：GCM 比特序下为整体右移 1 位，移出的位按 R = 0xE1 || 0^120 约简
+static inline u128 gf128_mul_x(u128 V) {
+    u64 r = 0 - (V.lo & 1);
+    V.lo = (V.lo >> 1) | (V.hi << 63);
+    V.hi = (V.hi >> 1) ^ (r & 0xE100000000000000ULL);
+    return V;
+}
+
+// Shoup 查表法的约简表：右移 4 位（或 8 位）时移出的低位 r 对高 16 位的贡献，
+// 与逐位右移 4（8）次的结果相同。REM4 即常见的 0x0000, 0x1C20, 0x3840, ... 一组常数
+struct GHASH_REM_TABLE {
+    u64 rem4[16];
+    u64 rem8[256];
+    GHASH_REM_TABLE() {
+        for (int r = 0; r < 256; ++r) {
+            u128 V{ 0, (u64)r };
+            for (int k = 0; k < 8; ++k) {
+                V = gf128_mul_x(V);
+                if (k == 3 && r < 16) rem4[r] = V.hi;
+            }
+            rem8[r] = V.hi;
+        }
+    }
+};
+static const GHASH_REM_TABLE GHASH_REM;
+
+// 每个密钥预计算一次的 GHASH 参数：
+// - H 及其 1..16 次幂。Htab[i] 为 H^(i+1)，按 __m128i 的内存顺序存放（[0] 为低 64 位），
+//   Hkar[i] 为 H^(i+1) 高低两半的异或，供 PCLMULQDQ 内核的 Karatsuba 中间项使用；
+//   Hrev[j] = H^(16-j)，连续 4 项正好是 VPCLMULQDQ 内核一个 zmm 中 4 个分组对应的幂；
+// - Shoup 4 位表 M4[n] = n·H（16 项共 256 字节）与 8 位表 M8[n] = n·H（256 项共 4KB），
+//   n 的最高位对应 x^0。只构造建密钥时所选内核用到的表，tables 记录已构造哪些；
+//   密钥建好后再切换到查表内核时，内核发现缺表就在栈上临时构造（见 ghash_blocks_table4/8）。
+//   各次幂只在有 PCLMULQDQ 时计算，没有时用到它们的内核不可能被选中
+enum : u8 { GHASH_TABLE4 = 1, GHASH_TABLE8 = 2 };
+
+struct GhashKey {
+    u128 H;
+    u8 tables;
+    alignas(16) u64 Htab[16][2];
+    u64 Hkar[16];
+    alignas(64) u64 Hrev[16][2];
+    u128 M4[16];
+    u128 M8[256];
+};
+
+// 按 n 的各个位把 H·x^k 异或起来：先填 2 的幂次项，其余项为两项之和
+static void ghash_build_table(u128* M, int bits, const u128& H) {
+    int n = 1 << bits;
+    M[0] = u128{ 0, 0 };
+    u128 V = H;
+    for (int i = n >> 1; i > 0; i >>= 1) {
+        M[i] = V;
+        V = gf128_mul_x(V);
+    }
+    for (int i = 2; i < n; i <<= 1)
+        for (int j = 1; j < i; ++j) M[i + j] = xor128(M[i], M[j]);
+}
+
+// GHASH 多分组接口：X <- (X ^ B_i)·H，依次吸收 nblocks 个 16 字节分组
+typedef void (*ghash_blocks_fn)(u128& X, const u8* data, size_t nblocks, const GhashKey& key);
+
+inline void ghash_blocks_generic(u128& X, const u8* data, size_t nblocks, const GhashKey& key) {
+    for (size_t i = 0; i < nblocks; ++i) ghash_update(X, data + 16 * i, key.H);
+}
+
+// Shoup 4 位查表：从最后一个字节起每次取半字节，Z <- Z·x^4 ^ M4[n]，
+// 右移 4 位移出的部分查 REM4 补回高位。每块 32 次查表，表 256 字节
+inline void ghash_blocks_table4(u128& X, const u8* data, size_t nblocks, const GhashKey& key) {
+    u128 local[16];
+    const u128* M = key.M4;
+    if (!(key.tables & GHASH_TABLE4)) {
+        ghash_build_table(local, 4, key.H);
+        M = local;
+    }
+    for (size_t b = 0; b < nblocks; ++b, data += 16) {
+        u128 Y = xor128(X, load_be128(data));
+        u128 Z{ 0, 0 };
+        for (int i = 0; i < 32; ++i) {
+            u64 w = i < 16 ? Y.lo : Y.hi;
+            u32 n = (u32)(w >> (4 * (i & 15))) & 0xF;
+            u64 rem = Z.lo & 0xF;
+            Z.lo = (Z.lo >> 4) | (Z.hi << 60);
+            Z.hi = (Z.hi >> 4) ^ GHASH_REM.rem4[rem];
+            Z.hi ^= M[n].hi;
+            Z.lo ^= M[n].lo;
+        }
+        X = Z;
+    }
+}
+
+// Shoup 8 位查表：每次取一个字节，Z <- Z·x^8 ^ M8[n]，每块 16 次查表，表 4KB。
+// 密钥建于其他内核之下时每次调用临时构造一遍表（约 600 周期），重建密钥后不再需要
+inline void ghash_blocks_table8(u128& X, const u8* data, size_t nblocks, const GhashKey& key) {
+    u128 local[256];
+    const u128* M = key.M8;
+    if (!(key.tables & GHASH_TABLE8)) {
+        ghash_build_table(local, 8, key.H);
+        M = local;
+    }
+    for (size_t b = 0; b < nblocks; ++b, data += 16) {
+        u128 Y = xor128(X, load_be128(data));
+        u128 Z{ 0, 0 };
+        for (int i = 0; i < 16; ++i) {
+            u64 w = i < 8 ? Y.lo : Y.hi;
+            u32 n = (u32)(w >> (8 * (i & 7))) & 0xFF;
+            u64 rem = Z.lo & 0xFF;
+            Z.lo = (Z.lo >> 8) | (Z.hi << 56);
+            Z.hi = (Z.hi >> 8) ^ GHASH_REM.rem8[rem];
+            Z.hi ^= M[n].hi;
+            Z.lo ^= M[n].lo;
+        }
+        X = Z;
+    }
+}
+
+// 256 位无进位积 hi:lo 的约简：输入为字节逆序后的 128 位整数（与 u128 的 hi/lo 一致）之积，
+// 整体左移 1 位修正比特反射，再按 x^128 + x^7 + x^2 + x + 1 约简
+SM4_TARGET("pclmul") static inline __m128i gf128_reduce_clmul(__m128i lo, __m128i hi) {
+    __m128i c_lo = _mm_srli_epi32(lo, 31);
+    __m128i c_hi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    hi = _mm_or_si128(hi, _mm_srli_si128(c_lo, 12));
+    hi = _mm_or_si128(hi, _mm_slli_si128(c_hi, 4));
+    lo = _mm_or_si128(lo, _mm_slli_si128(c_lo, 4));
+
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i t_hi = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    __m128i r = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    r = _mm_xor_si128(r, t_hi);
+    return _mm_xor_si128(hi, _mm_xor_si128(lo, r));
+}
+
+// 单个乘法：4 次 64x64 无进位乘得到 256 位积后约简
+SM4_TARGET("pclmul") static inline __m128i gf128_mul_clmul(__m128i a, __m128i b) {
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return gf128_reduce_clmul(lo, hi);
+}
+
+// 8 块聚合：X' = (X ^ B0)·H^8 ^ B1·H^7 ^ ... ^ B7·H。每个乘法用 Karatsuba（3 次 PCLMULQDQ），
+// 8 个未约简的积先异或累加，每 8 块只做一次移位与约简
+SM4_TARGET("pclmul,ssse3") static SM4_FORCEINLINE __m128i ghash8_clmul(__m128i x, const u8* data, const GhashKey& key) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128(), mid = _mm_setzero_si128();
+    for (int j = 0; j < 8; ++j) {
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * j)), bswap);
+        if (j == 0) b = _mm_xor_si128(b, x);
+        __m128i h = _mm_load_si128((const __m128i*)key.Htab[7 - j]);
+        __m128i hk = _mm_loadl_epi64((const __m128i*)&key.Hkar[7 - j]);
+        lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(b, h, 0x00));
+        hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(b, h, 0x11));
+        __m128i bk = _mm_xor_si128(b, _mm_srli_si128(b, 8));
+        mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(bk, hk, 0x00));
+    }
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return gf128_reduce_clmul(lo, hi);
+}
+
+// 不足 8 块的尾部逐块处理
+SM4_TARGET("pclmul,ssse3") inline void ghash_blocks_pclmul(u128& X, const u8* data, size_t nblocks, const GhashKey& key) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i x = _mm_set_epi64x((long long)X.hi, (long long)X.lo);
+    for (; nblocks >= 8; nblocks -= 8, data += 128) x = ghash8_clmul(x, data, key);
+    __m128i h = _mm_load_si128((const __m128i*)key.Htab[0]);
+    for (size_t i = 0; i < nblocks; ++i) {
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+        x = gf128_mul_clmul(_mm_xor_si128(x, b), h);
+    }
+    alignas(16) u64 w[2];
+    _mm_store_si128((__m128i*)w, x);
+    X.lo = w[0];
+    X.hi = w[1];
+}
+
+// VPCLMULQDQ：每个 zmm 放 4 个分组，16 块 B0..B15 分别乘 H^16..H^1，每个 zmm 4 次乘法
+// （lo、hi 与两个交叉项），4 个 128 位通道的积异或折叠后只做一次约简
+SM4_TARGET("avx512f,avx512bw,vpclmulqdq,pclmul,ssse3")
+static SM4_FORCEINLINE __m128i ghash16_vpclmul(__m128i x, const u8* data, const GhashKey& key) {
+    const __m512i bswap = _mm512_broadcast_i32x4(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __m512i lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512(), mid = _mm512_setzero_si512();
+    for (int k = 0; k < 4; ++k) {
+        __m512i b = _mm512_shuffle_epi8(_mm512_loadu_si512((const void*)(data + 64 * k)), bswap);
+        if (k == 0) b = _mm512_xor_si512(b, _mm512_maskz_mov_epi64(0x03, _mm512_castsi128_si512(x)));
+        __m512i h = _mm512_load_si512((const void*)key.Hrev[4 * k]);
+        lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(b, h, 0x00));
+        hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(b, h, 0x11));
+        mid = _mm512_ternarylogic_epi64(mid, _mm512_clmulepi64_epi128(b, h, 0x01), _mm512_clmulepi64_epi128(b, h, 0x10), 0x96);
+    }
+    __m256i l2 = _mm256_xor_si256(_mm512_castsi512_si256(lo), _mm512_extracti64x4_epi64(lo, 1));
+    __m256i h2 = _mm256_xor_si256(_mm512_castsi512_si256(hi), _mm512_extracti64x4_epi64(hi, 1));
+    __m256i m2 = _mm256_xor_si256(_mm512_castsi512_si256(mid), _mm512_extracti64x4_epi64(mid, 1));
+    __m128i l1 = _mm_xor_si128(_mm256_castsi256_si128(l2), _mm256_extracti128_si256(l2, 1));
+    __m128i h1 = _mm_xor_si128(_mm256_castsi256_si128(h2), _mm256_extracti128_si256(h2, 1));
+    __m128i m1 = _mm_xor_si128(_mm256_castsi256_si128(m2), _mm256_extracti128_si256(m2, 1));
+    l1 = _mm_xor_si128(l1, _mm_slli_si128(m1, 8));
+    h1 = _mm_xor_si128(h1, _mm_srli_si128(m1, 8));
+    return gf128_reduce_clmul(l1, h1);
+}
+
+SM4_TARGET("avx512f,avx512bw,vpclmulqdq,pclmul,ssse3")
+inline void ghash_blocks_vpclmul(u128& X, const u8* data, size_t nblocks, const GhashKey& key) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i x = _mm_set_epi64x((long long)X.hi, (long long)X.lo);
+    for (; nblocks >= 16; nblocks -= 16, data += 256) x = ghash16_vpclmul(x, data, key);
+    for (; nblocks >= 8; nblocks -= 8, data += 128) x = ghash8_clmul(x, data, key);
+    __m128i h = _mm_load_si128((const __m128i*)key.Htab[0]);
+    for (size_t i = 0; i < nblocks; ++i) {
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+        x = gf128_mul_clmul(_mm_xor_si128(x, b), h);
+    }
+    alignas(16) u64 w[2];
+    _mm_store_si128((__m128i*)w, x);
+    X.lo = w[0];
+    X.hi = w[1];
+}
+
+SM4_TARGET("pclmul") static u128 gfmul128_clmul(u128 a, u128 b) {
+    __m128i r = gf128_mul_clmul(_mm_set_epi64x((long long)a.hi, (long long)a.lo), _mm_set_epi64x((long long)b.hi, (long long)b.lo));
+    alignas(16) u64 w[2];
+    _mm_store_si128((__m128i*)w, r);
+    return u128{ w[1], w[0] };
+}
+
+// 每个密钥执行一次：有 PCLMULQDQ 时用无进位乘法计算 H 的各次幂，tables 指定要构造的 Shoup 表。
+// 不触发内核选择，供 GHASH_DISPATCH 自检使用；其他调用方用 ghash_key_init
+static void ghash_key_build(GhashKey& gk, const u128& H, u8 tables) {
+    gk.H = H;
+    gk.tables = tables;
+    if (sm4_cpu_features() & SM4_CPU_PCLMUL) {
+        u128 P = H;
+        for (int i = 0; i < 16; ++i) {
+            gk.Htab[i][0] = gk.Hrev[15 - i][0] = P.lo;
+            gk.Htab[i][1] = gk.Hrev[15 - i][1] = P.hi;
+            gk.Hkar[i] = P.hi ^ P.lo;
+            P = gfmul128_clmul(P, H);
+        }
+    }
+    if (tables & GHASH_TABLE4) ghash_build_table(gk.M4, 4, H);
+    if (tables & GHASH_TABLE8) ghash_build_table(gk.M8, 8, H);
+}
+
+// GHASH 内核选择，环境变量 GHASH_KERNEL 可强制为 vpclmul、pclmul、table8、table4 或 generic
+struct GhashKernelInfo {
+    const char* name;
+    u32 need;
+    ghash_blocks_fn blocks;
+    u8 tables;  // 建密钥时需要构造的 Shoup 表
+};
+static const GhashKernelInfo GHASH_KERNELS[] = {
+    { "vpclmul", SM4_CPU_VPCLMUL | SM4_CPU_AVX512F | SM4_CPU_AVX512BW | SM4_CPU_PCLMUL | SM4_CPU_SSSE3, ghash_blocks_vpclmul, 0 },
+    { "pclmul", SM4_CPU_PCLMUL | SM4_CPU_SSSE3, ghash_blocks_pclmul, 0 },
+    { "table8", 0, ghash_blocks_table8, GHASH_TABLE8 },
+    { "table4", 0, ghash_blocks_table4, GHASH_TABLE4 },
+    { "generic", 0, ghash_blocks_generic, 0 },
+};
+
+struct GHASH_DISPATCH_TABLE {
+    std::once_flag once;
+    const GhashKernelInfo* kernel = &GHASH_KERNELS[4];
+    ghash_blocks_fn blocks = ghash_blocks_generic;
+
+    // 与逐位乘法 gfmul128_slow 比对 0..40 个分组的输入（覆盖 16/8 块聚合与尾部），防止选中结果不一致的内核
+    static bool self_check(ghash_blocks_fn fn) {
+        u8 data[40 * 16];
+        for (int i = 0; i < 40 * 16; ++i) data[i] = (u8)(i * 73 + 5);
+        u128 H{ 0x66e94bd4ef8a2c3bULL, 0x884cfa59ca342b2eULL };
+        GhashKey gk;
+        ghash_key_build(gk, H, GHASH_TABLE4 | GHASH_TABLE8);
+        for (size_t n = 0; n <= 40; ++n) {
+            u128 X1{ 0x0123456789abcdefULL, 0xfedcba9876543210ULL }, X2 = X1;
+            for (size_t i = 0; i < n; ++i) ghash_update(X1, data + 16 * i, H);
+            fn(X2, data, n, gk);
+            if (X1.hi != X2.hi || X1.lo != X2.lo) return false;
+        }
+        return true;
+    }
+
+    bool select(const char* name) {
+        bool automatic = name == nullptr || strcmp(name, "auto") == 0;
+        u32 cpu = sm4_cpu_features();
+        for (const GhashKernelInfo& k : GHASH_KERNELS) {
+            if (!automatic && strcmp(name, k.name) != 0) continue;
+            if ((cpu & k.need) != k.need) {
+                if (automatic) continue;
+                return false;
+            }
+            if (automatic && !self_check(k.blocks)) continue;
+            kernel = &k;
+            blocks = k.blocks;
+            return true;
+        }
+        return false;
+    }
+
+    // 由 call_once 保证只执行一次（与 SM4_DISPATCH.init 相同）；ghash_key_init 与 Sm4GcmKey 构造密钥前都会调用
+    void init() {
+        std::call_once(once, [this] {
+            const char* env = getenv("GHASH_KERNEL");
+            if (env && *env && !select(env)) {
+                fprintf(stderr, "GHASH_KERNEL=%s 未知或本机不支持，改为自动选择\n", env);
+                env = nullptr;
+            }
+            if (!env || !*env) select(nullptr);
+        });
+    }
+};
+inline GHASH_DISPATCH_TABLE GHASH_DISPATCH;
+
+// 只构造当前所选内核需要的表；要在多个查表内核之间比较时用第二个重载显式指定
+inline void ghash_key_init(GhashKey& gk, const u128& H, u8 tables) {
+    GHASH_DISPATCH.init();
+    ghash_key_build(gk, H, tables);
+}
+
+inline void ghash_key_init(GhashKey& gk, const u128& H) {
+    GHASH_DISPATCH.init();
+    ghash_key_build(gk, H, GHASH_DISPATCH.kernel->tables);
+}
+
+// ---------------------------
+// 拼接（stitched）的 GCTR + GHASH：一次遍历数据，每组计数器分组交给多分组 SM4 内核的同时，
+// 把上一组密文（解密时为本组密文）吸收进 GHASH，两者没有数据依赖，可以在不同执行端口上重叠。
+// 只处理整块，ctr 为下一个计数器分组（调用后已按 inc32 前进），X 为 GHASH 累加值。
+// ---------------------------
+// 通用版本：经 SM4_DISPATCH 与 GHASH_DISPATCH 调用各自的内核。所选 SM4 内核的宽度 W 可以是
+// 1、4、8、16、64 或 256，每组取 G = W 向上取整到 8 的倍数（W < 8 时一组含几批），GHASH 每次吸收
+// 8 的倍数个分组，PCLMULQDQ 内核的 8 块聚合不会因 W 小而退化为逐块；G 都整除 SM4_MODE_CHUNK，
+// 只有消息最后不足一组的部分单独成组，其密钥流同样交给 sm4_encrypt_blocks（尾部补齐成整批）
+inline void gcm_crypt_blocks_generic(bool decrypt, const u32 rk[32], const GhashKey& gk, u128& X, u8 ctr[16],
+    const u8* in, u8* out, size_t nblocks) {
+    const size_t G = ((size_t)SM4_DISPATCH.multi_blocks + 7) & ~(size_t)7;
+    u8 cb[SM4_MODE_CHUNK * 16], ks[SM4_MODE_CHUNK * 16];
+    const u8* pending = nullptr;
+    size_t pending_n = 0;
+    while (nblocks) {
+        // 计数器按整段提前写好，内核载入时这些写入早已完成
+        size_t n = nblocks < SM4_MODE_CHUNK ? nblocks : SM4_MODE_CHUNK;
+        ctr32_fill(cb, ctr, n);
+        for (size_t g = 0; g < n; ) {
+            size_t m = n - g < G ? n - g : G;
+            sm4_encrypt_blocks(cb + 16 * g, ks, m, rk);
+            if (decrypt) GHASH_DISPATCH.blocks(X, in, m, gk);
+            else if (pending) GHASH_DISPATCH.blocks(X, pending, pending_n, gk);
+            xor_bytes(out, in, ks, 16 * m);
+            pending = out;
+            pending_n = m;
+            g += m;
+            in += 16 * m;
+            out += 16 * m;
+        }
+        nblocks -= n;
+    }
+    if (!decrypt && pending) GHASH_DISPATCH.blocks(X, pending, pending_n, gk);
+}
+
+// AVX-512 + GFNI + VPCLMULQDQ 融合版本：flatten 把 16 块 GFNI 内核与 16 块 GHASH 内联进同一个
+// 循环体，SM4 的 GF2P8AFFINE 与 GHASH 的 VPCLMULQDQ 在同一段指令流中由乱序执行交错
+SM4_TARGET_FLATTEN("avx512f,avx512bw,gfni,vpclmulqdq,pclmul,ssse3")
+inline void gcm_crypt_blocks_avx512_gfni(bool decrypt, const u32 rk[32], const GhashKey& gk, u128& X, u8 ctr[16],
+    const u8* in, u8* out, size_t nblocks) {
+    alignas(64) u8 cb[16 * 16], ks[16 * 16];
+    __m128i x = _mm_set_epi64x((long long)X.hi, (long long)X.lo);
+    // 计数器在寄存器中生成：最后 4 字节换成小端后按 32 位相加（即 inc32 的回绕），写回时再换回大端；
+    // 整个 zmm 一次写入 cb，避免内核的 64 字节载入跨越多次小写入导致存储转发失败
+    const __m512i ctr_swap = _mm512_broadcast_i32x4(_mm_set_epi8(12, 13, 14, 15, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    __m512i c = _mm512_shuffle_epi8(_mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)ctr)), ctr_swap);
+    c = _mm512_add_epi32(c, _mm512_set_epi32(3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0));
+    const __m512i four = _mm512_set_epi32(4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0);
+    const u8* pending = nullptr;
+    for (; nblocks >= 16; nblocks -= 16, in += 256, out += 256) {
+        for (int k = 0; k < 4; ++k) {
+            _mm512_store_si512((void*)(cb + 64 * k), _mm512_shuffle_epi8(c, ctr_swap));
+            c = _mm512_add_epi32(c, four);
+        }
+        ctr32_add(ctr, 16);
+        sm4_encrypt_16blocks_avx512_gfni(cb, ks, rk);
+        const u8* h = decrypt ? in : pending;
+        if (h) x = ghash16_vpclmul(x, h, gk);
+        for (int i = 0; i < 4; ++i) {
+            __m512i d = _mm512_loadu_si512((const void*)(in + 64 * i));
+            __m512i k = _mm512_load_si512((const void*)(ks + 64 * i));
+            _mm512_storeu_si512((void*)(out + 64 * i), _mm512_xor_si512(d, k));
+        }
+        pending = out;
+    }
+    if (!decrypt && pending) x = ghash16_vpclmul(x, pending, gk);
+    alignas(16) u64 w[2];
+    _mm_store_si128((__m128i*)w, x);
+    X.lo = w[0];
+    X.hi = w[1];
+    gcm_crypt_blocks_generic(decrypt, rk, gk, X, ctr, in, out, nblocks);
+}
+
+// 按当前选中的 SM4 与 GHASH 内核选择拼接循环
+inline void gcm_crypt_blocks(bool decrypt, const u32 rk[32], const GhashKey& gk, u128& X, u8 ctr[16],
+    const u8* in, u8* out, size_t nblocks) {
+    if (SM4_DISPATCH.encrypt_multi == sm4_encrypt_16blocks_avx512_gfni && GHASH_DISPATCH.blocks == ghash_blocks_vpclmul)
+        gcm_crypt_blocks_avx512_gfni(decrypt, rk, gk, X, ctr, in, out, nblocks);
+    else
+        gcm_crypt_blocks_generic(decrypt, rk, gk, X, ctr, in, out, nblocks);
+}
+
+// ---------------------------
+// 密钥上下文与流式接口
+// ---------------------------
+// 与密钥绑定、可被任意多条消息复用的部分：轮密钥、H 及 GHASH 的各次幂/查找表。
+// 查找表只为构造时所选的 GHASH 内核生成；之后切换 GHASH_DISPATCH 仍然正确，
+// 只是切换到查表内核时每次调用要临时建表，重新 init 即可恢复。
+struct Sm4GcmKey {
+    alignas(64) u32 rk[32];
+    GhashKey gk;
+
+    Sm4GcmKey() {}
+    explicit Sm4GcmKey(const u8 key[16]) { init(key); }
+
+    void init(const u8 key[16]) {
+        u32 k[32];
+        sm4_key_expand(key, k);
+        init_rk(k);
+    }
+
+    // 轮密钥已由调用方生成（如 sm4_key_expand_batch），只计算 H 与 GHASH 表。
+    // H = E(0) 经 encrypt_block：所选内核为常数时间时它绑定的也是常数时间的单分组实现，不走 T 表
+    void init_rk(const u32 key_rk[32]) {
+        SM4_DISPATCH.init();
+        u8 zero[16] = { 0 };
+        u8 Hblock[16];
+        SM4_DISPATCH.encrypt_block(zero, Hblock, key_rk);
+        init_rk_h(key_rk, Hblock);
+    }
+
+    // 轮密钥与 H = E(0) 都已由调用方算好（如 Sm4KeyCache::warm 在多密钥通道中成组计算）
+    void init_rk_h(const u32 key_rk[32], const u8 Hblock[16]) {
+        memcpy(rk, key_rk, sizeof(rk));
+        ghash_key_init(gk, load_be128(Hblock));
+    }
+};
+
+// 截断标签的最短长度（字节）
+static const size_t SM4_GCM_MIN_TAG_LEN = 12;
+
+// 标签比较：累积所有字节的差异，不因第一个不同的字节提前返回
+static bool gcm_tag_equal(const u8* a, const u8* b, size_t n) {
+    u8 diff = 0;
+    for (size_t i = 0; i < n; ++i) diff |= (u8)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+// 清除认证失败时已写出的明文；经 volatile 指针写入，不会被当作无用存储优化掉
+static void gcm_secure_zero(u8* p, size_t n) {
+    volatile u8* v = p;
+    for (size_t i = 0; i < n; ++i) v[i] = 0;
+}
+
+// 单条消息的状态：init(iv) -> update_aad* -> update* -> final / verify。
+// update_aad 与 update 都可以按任意长度分多次调用，不足一块的部分在调用之间保存在 buf 中；
+// 第一次 update 之后不能再追加 AAD。decrypt 为 true 时 update 做解密（GHASH 吸收输入的密文）；
+// 只需认证时用 update_verify_only 代替 update，只计算 GHASH、不生成密钥流，最后 verify。
+struct Sm4GcmCtx {
+    const Sm4GcmKey* key = nullptr;
+    bool decrypt = false;
+    bool aad_done = false;
+    u128 X{ 0, 0 };
+    u8 J0[16];
+    u8 ctr[16];         // 下一个计数器分组
+    u8 ks[16];          // 当前不完整分组的密钥流
+    u8 buf[16];         // 当前不完整分组（AAD 或密文）
+    size_t buf_len = 0;
+    u64 aad_len = 0, text_len = 0;
+
+    void init(const Sm4GcmKey& k, const u8 iv[12], bool dec = false) {
+        key = &k;
+        decrypt = dec;
+        aad_done = false;
+        X = u128{ 0, 0 };
+        memcpy(J0, iv, 12);
+        J0[12] = 0; J0[13] = 0; J0[14] = 0; J0[15] = 1;
+        memcpy(ctr, J0, 16);
+        ctr32_add(ctr, 1);
+        buf_len = 0;
+        aad_len = text_len = 0;
+    }
+
+    // 吸收不足一块的剩余部分（补 0）
+    void flush_partial() {
+        if (buf_len == 0) return;
+        memset(buf + buf_len, 0, 16 - buf_len);
+        GHASH_DISPATCH.blocks(X, buf, 1, key->gk);
+        buf_len = 0;
+    }
+
+    void update_aad(const u8* aad, size_t len) {
+        aad_len += len;
+        if (buf_len) {
+            size_t n = 16 - buf_len < len ? 16 - buf_len : len;
+            memcpy(buf + buf_len, aad, n);
+            buf_len += n; aad += n; len -= n;
+            if (buf_len < 16) return;
+            GHASH_DISPATCH.blocks(X, buf, 1, key->gk);
+            buf_len = 0;
+        }
+        GHASH_DISPATCH.blocks(X, aad, len / 16, key->gk);
+        aad += len - len % 16;
+        buf_len = len % 16;
+        if (buf_len) memcpy(buf, aad, buf_len);
+    }
+
+    void update(const u8* in, u8* out, size_t len) {
+        if (!aad_done) {
+            flush_partial();
+            aad_done = true;
+        }
+        text_len += len;
+        // 先用完上一次剩下的密钥流，凑满一块后吸收进 GHASH
+        if (buf_len) {
+            size_t n = 16 - buf_len < len ? 16 - buf_len : len;
+            for (size_t i = 0; i < n; ++i) {
+                u8 c = decrypt ? in[i] : (u8)(in[i] ^ ks[buf_len + i]);
+                out[i] = in[i] ^ ks[buf_len + i];
+                buf[buf_len + i] = c;
+            }
+            buf_len += n; in += n; out += n; len -= n;
+            if (buf_len < 16) return;
+            GHASH_DISPATCH.blocks(X, buf, 1, key->gk);
+            buf_len = 0;
+        }
+        gcm_crypt_blocks(decrypt, key->rk, key->gk, X, ctr, in, out, len / 16);
+        in += len - len % 16;
+        out += len - len % 16;
+        len %= 16;
+        if (len) {
+            SM4_DISPATCH.encrypt_block(ctr, ks, key->rk);
+            ctr32_add(ctr, 1);
+            for (size_t i = 0; i < len; ++i) {
+                u8 c = decrypt ? in[i] : (u8)(in[i] ^ ks[i]);
+                out[i] = in[i] ^ ks[i];
+                buf[i] = c;
+            }
+            buf_len = len;
+        }
+    }
+
+    // 只把密文吸收进 GHASH（不解密），与 update 不能在同一条消息中混用
+    void update_verify_only(const u8* in, size_t len) {
+        if (!aad_done) {
+            flush_partial();
+            aad_done = true;
+        }
+        text_len += len;
+        if (buf_len) {
+            size_t n = 16 - buf_len < len ? 16 - buf_len : len;
+            memcpy(buf + buf_len, in, n);
+            buf_len += n; in += n; len -= n;
+            if (buf_len < 16) return;
+            GHASH_DISPATCH.blocks(X, buf, 1, key->gk);
+            buf_len = 0;
+        }
+        GHASH_DISPATCH.blocks(X, in, len / 16, key->gk);
+        in += len - len % 16;
+        buf_len = len % 16;
+        if (buf_len) memcpy(buf, in, buf_len);
+    }
+
+    void final(u8 tag_out[16]) {
+        flush_partial();
+        u8 lenblock[16];
+        u64 aadbits = aad_len * 8, ctxtbits = text_len * 8;
+        for (int b = 0; b < 8; ++b) lenblock[7 - b] = (u8)(aadbits >> (8 * b));
+        for (int b = 0; b < 8; ++b) lenblock[15 - b] = (u8)(ctxtbits >> (8 * b));
+        GHASH_DISPATCH.blocks(X, lenblock, 1, key->gk);
+
+        u8 Sblock[16];
+        SM4_DISPATCH.encrypt_block(J0, Sblock, key->rk);
+        for (int k = 0; k < 8; ++k) tag_out[k] = Sblock[k] ^ (u8)(X.hi >> (56 - 8 * k));
+        for (int k = 0; k < 8; ++k) tag_out[8 + k] = Sblock[8 + k] ^ (u8)(X.lo >> (56 - 8 * k));
+    }
+
+    // 计算标签并与 tag 做常数时间比较。截断标签只接受 12~16 字节（NIST SP 800-38D 的 96~128 位），
+    // 更短的标签伪造概率过高（1 字节为 2^-8），一律拒绝
+    bool verify(const u8 tag[16], size_t tag_len = 16) {
+        u8 t[16];
+        final(t);
+        if (tag_len < SM4_GCM_MIN_TAG_LEN || tag_len > 16) return false;
+        return gcm_tag_equal(t, tag, tag_len);
+    }
+};
+
+// 复用密钥上下文的一次性加密
+inline void sm4_gcm_encrypt(const Sm4GcmKey& gkey, const u8 iv[12], const u8* plaintext, size_t plen,
+    const u8* aad, size_t aadlen,
+    u8* ciphertext, u8 tag_out[16])
+{
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv);
+    ctx.update_aad(aad, aadlen);
+    ctx.update(plaintext, ciphertext, plen);
+    ctx.final(tag_out);
+}
+
+// 一次遍历完成解密与 GHASH（拼接循环中 GHASH 吸收的是输入密文），最后常数时间比较标签。
+// 认证失败时返回 false，并把已写入 plaintext 的内容清零，调用方拿不到未经认证的明文；
+// plaintext 可以与 ciphertext 相同（失败时该缓冲区同样被清零）。
+inline bool sm4_gcm_decrypt(const Sm4GcmKey& gkey, const u8 iv[12], const u8* ciphertext, size_t clen,
+    const u8* aad, size_t aadlen, const u8 tag[16], u8* plaintext)
+{
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv, true);
+    ctx.update_aad(aad, aadlen);
+    ctx.update(ciphertext, plaintext, clen);
+    if (ctx.verify(tag)) return true;
+    gcm_secure_zero(plaintext, clen);
+    return false;
+}
+
+// 只验证标签：GHASH 遍历 AAD 与密文，只加密一个分组 J0，不生成密钥流也不输出明文
+inline bool sm4_gcm_verify(const Sm4GcmKey& gkey, const u8 iv[12], const u8* ciphertext, size_t clen,
+    const u8* aad, size_t aadlen, const u8 tag[16])
+{
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv, true);
+    ctx.update_aad(aad, aadlen);
+    ctx.update_verify_only(ciphertext, clen);
+    return ctx.verify(tag);
+}
+
+inline bool sm4_gcm_decrypt(const u8 key[16], const u8 iv[12], const u8* ciphertext, size_t clen,
+    const u8* aad, size_t aadlen, const u8 tag[16], u8* plaintext)
+{
+    Sm4GcmKey gkey(key);
+    return sm4_gcm_decrypt(gkey, iv, ciphertext, clen, aad, aadlen, tag, plaintext);
+}
+
+// ---------------------------
+// 分段输入输出（scatter/gather）：网络与存储层的记录是若干段组成的链，不必先拷贝到连续缓冲区。
+// 输入、输出各是一个段列表，两边的段边界可以不同，总长度必须相等。
+// ---------------------------
+// 与 POSIX struct iovec 的两个字段对应
+struct Sm4IoVec {
+    u8* base;
+    size_t len;
+};
+
+static size_t gcm_iov_total(const Sm4IoVec* v, size_t n) {
+    size_t t = 0;
+    for (size_t i = 0; i < n; ++i) t += v[i].len;
+    return t;
+}
+
+// 段列表上的读写位置
+struct GcmIovCursor {
+    const Sm4IoVec* v;
+    size_t n, i = 0, off = 0;
+
+    GcmIovCursor(const Sm4IoVec* v_, size_t n_) : v(v_), n(n_) {}
+    void skip_empty() { while (i < n && off == v[i].len) { ++i; off = 0; } }
+    size_t avail() const { return v[i].len - off; }
+    u8* ptr() const { return v[i].base + off; }
+    void advance(size_t len) {
+        while (len) {
+            skip_empty();
+            size_t k = avail() < len ? avail() : len;
+            off += k; len -= k;
+        }
+    }
+    // 从当前位置起收集 len 字节到 dst / 把 src 的 len 字节分散写到当前位置起
+    void gather(u8* dst, size_t len) {
+        while (len) {
+            skip_empty();
+            size_t k = avail() < len ? avail() : len;
+            memcpy(dst, ptr(), k);
+            dst += k; off += k; len -= k;
+        }
+    }
+    void scatter(const u8* src, size_t len) {
+        while (len) {
+            skip_empty();
+            size_t k = avail() < len ? avail() : len;
+            memcpy(ptr(), src, k);
+            src += k; off += k; len -= k;
+        }
+    }
+};
+
+// 同时沿两个段列表前进，以 C = SM4_MODE_CHUNK 个分组（4KB，是任何内核一组的整数倍）为单位：
+// 两边当前段都还有至少 C 字节时，整 C 的部分直接在段内原地交给拼接循环；否则从输入跨段收集
+// 一整段 C（或消息剩余部分）到暂存缓冲区，处理后再分散写回输出。短段（如 1448 字节的 TCP 段）
+// 因此与先拷贝到连续缓冲区一样每 4KB 只调用一次 update，长段则省去两次拷贝；除消息末尾外每次
+// update 都是整批，位置始终 16 字节对齐，不会出现逐块处理的分组。
+// 输出可以与输入是同一块内存（原地加解密，两边的段划分可以不同），其他形式的重叠不允许。
+static void gcm_update_iov(Sm4GcmCtx& ctx, const Sm4IoVec* in, size_t nin, const Sm4IoVec* out, size_t nout, size_t total) {
+    const size_t C = 16 * SM4_MODE_CHUNK;
+    u8 carry[16 * SM4_MODE_CHUNK];
+    GcmIovCursor ci(in, nin), co(out, nout);
+    size_t used = 0;
+    while (total) {
+        ci.skip_empty();
+        co.skip_empty();
+        size_t n = ci.avail() < co.avail() ? ci.avail() : co.avail();
+        if (n >= C) {
+            n -= n % C;
+            ctx.update(ci.ptr(), co.ptr(), n);
+            ci.advance(n);
+            co.advance(n);
+        } else {
+            n = total < C ? total : C;
+            ci.gather(carry, n);
+            ctx.update(carry, carry, n);
+            co.scatter(carry, n);
+            if (n > used) used = n;
+        }
+        total -= n;
+    }
+    // 加密时暂存区最后只剩密文；解密时是尚未认证的明文，需要清除
+    if (ctx.decrypt && used) gcm_secure_zero(carry, used);
+}
+
+// 输入与输出总长度不同时返回 false，不做任何处理
+inline bool sm4_gcm_encrypt_iov(const Sm4GcmKey& gkey, const u8 iv[12], const Sm4IoVec* in, size_t nin,
+    const u8* aad, size_t aadlen, const Sm4IoVec* out, size_t nout, u8 tag_out[16])
+{
+    size_t total = gcm_iov_total(in, nin);
+    if (total != gcm_iov_total(out, nout)) return false;
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv);
+    ctx.update_aad(aad, aadlen);
+    gcm_update_iov(ctx, in, nin, out, nout, total);
+    ctx.final(tag_out);
+    return true;
+}
+
+// 认证失败时把全部输出段清零，与 sm4_gcm_decrypt 一致
+inline bool sm4_gcm_decrypt_iov(const Sm4GcmKey& gkey, const u8 iv[12], const Sm4IoVec* in, size_t nin,
+    const u8* aad, size_t aadlen, const u8 tag[16], const Sm4IoVec* out, size_t nout)
+{
+    size_t total = gcm_iov_total(in, nin);
+    if (total != gcm_iov_total(out, nout)) return false;
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv, true);
+    ctx.update_aad(aad, aadlen);
+    gcm_update_iov(ctx, in, nin, out, nout, total);
+    if (ctx.verify(tag)) return true;
+    for (size_t j = 0; j < nout; ++j) gcm_secure_zero(out[j].base, out[j].len);
+    return false;
+}
+
+// ---------------------------
+// 多条小消息批处理：同一密钥下 N 条各自带 IV 的记录，把所有记录的 J0 与计数器分组拼在一起，
+// 一次交给 sm4_encrypt_blocks，由多分组内核填满 SIMD 通道；每条记录各自的 GHASH 累加值单独计算。
+// ---------------------------
+struct Sm4GcmBatchItem {
+    const u8* iv;       // 12 字节
+    const u8* aad;
+    size_t aadlen;
+    const u8* in;       // 加密时为明文，解密时为密文
+    size_t len;
+    u8* out;            // 可以与 in 相同
+    u8* tag;            // 加密时输出 16 字节标签，解密时为待验证的标签
+    bool ok;            // 解密时标签是否正确（失败时 out 已清零）
+};
+
+// 一条消息的 GHASH：AAD、数据（均补 0 到整块）与长度块
+static u128 gcm_ghash_message(const GhashKey& gk, const u8* aad, size_t aadlen, const u8* data, size_t len) {
+    u128 X{ 0, 0 };
+    u8 block[16];
+    GHASH_DISPATCH.blocks(X, aad, aadlen / 16, gk);
+    if (aadlen % 16) {
+        memset(block, 0, 16);
+        memcpy(block, aad + aadlen - aadlen % 16, aadlen % 16);
+        GHASH_DISPATCH.blocks(X, block, 1, gk);
+    }
+    GHASH_DISPATCH.blocks(X, data, len / 16, gk);
+    if (len % 16) {
+        memset(block, 0, 16);
+        memcpy(block, data + len - len % 16, len % 16);
+        GHASH_DISPATCH.blocks(X, block, 1, gk);
+    }
+    u64 aadbits = (u64)aadlen * 8, ctxtbits = (u64)len * 8;
+    for (int b = 0; b < 8; ++b) block[7 - b] = (u8)(aadbits >> (8 * b));
+    for (int b = 0; b < 8; ++b) block[15 - b] = (u8)(ctxtbits >> (8 * b));
+    GHASH_DISPATCH.blocks(X, block, 1, gk);
+    return X;
+}
+
+// 每条记录占 1 + ceil(len/16) 个分组（J0 与计数器），累计不超过 SM4_MODE_CHUNK 时放在同一批
+static void gcm_batch_flush(const Sm4GcmKey& gkey, Sm4GcmBatchItem* items, size_t n, bool decrypt) {
+    u8 ks[SM4_MODE_CHUNK * 16];
+    size_t total = 0, m = 0;
+    do {  // 调用方保证 n >= 1
+        // J0 之后紧接 inc32(J0) 起的计数器分组
+        u8 ctr[16];
+        memcpy(ctr, items[m].iv, 12);
+        ctr[12] = 0; ctr[13] = 0; ctr[14] = 0; ctr[15] = 1;
+        size_t nb = 1 + (items[m].len + 15) / 16;
+        ctr32_fill(ks + 16 * total, ctr, nb);
+        total += nb;
+    } while (++m < n);
+    // 补齐到内核宽度（SM4_MODE_CHUNK 是其倍数），尾部不再逐块走单分组实现；补齐分组的结果不使用
+    const size_t W = (size_t)SM4_DISPATCH.multi_blocks;
+    size_t padded = (total + W - 1) / W * W;
+    memset(ks + 16 * total, 0, 16 * (padded - total));
+    sm4_encrypt_blocks(ks, ks, padded, gkey.rk);
+
+    size_t pos = 0;
+    for (m = 0; m < n; ++m) {
+        Sm4GcmBatchItem& it = items[m];
+        const u8* s = ks + 16 * pos;
+        u128 X;
+        if (decrypt) X = gcm_ghash_message(gkey.gk, it.aad, it.aadlen, it.in, it.len);
+        xor_bytes(it.out, it.in, s + 16, it.len);
+        if (!decrypt) X = gcm_ghash_message(gkey.gk, it.aad, it.aadlen, it.out, it.len);
+        u8 t[16];
+        for (int k = 0; k < 8; ++k) t[k] = s[k] ^ (u8)(X.hi >> (56 - 8 * k));
+        for (int k = 0; k < 8; ++k) t[8 + k] = s[8 + k] ^ (u8)(X.lo >> (56 - 8 * k));
+        if (decrypt) {
+            it.ok = gcm_tag_equal(t, it.tag, 16);
+            if (!it.ok) gcm_secure_zero(it.out, it.len);
+        } else {
+            memcpy(it.tag, t, 16);
+            it.ok = true;
+        }
+        pos += 1 + (it.len + 15) / 16;
+    }
+}
+
+// 超过一批容量的长记录单独走拼接循环；其余按顺序装批
+static void gcm_crypt_batch(const Sm4GcmKey& gkey, Sm4GcmBatchItem* items, size_t n, bool decrypt) {
+    SM4_DISPATCH.init();
+    size_t first = 0, blocks = 0;
+    for (size_t m = 0; m < n; ++m) {
+        size_t need = 1 + (items[m].len + 15) / 16;
+        if (need > SM4_MODE_CHUNK) {
+            Sm4GcmBatchItem& it = items[m];
+            if (decrypt) it.ok = sm4_gcm_decrypt(gkey, it.iv, it.in, it.len, it.aad, it.aadlen, it.tag, it.out);
+            else {
+                Sm4GcmCtx ctx;
+                ctx.init(gkey, it.iv);
+                ctx.update_aad(it.aad, it.aadlen);
+                ctx.update(it.in, it.out, it.len);
+                ctx.final(it.tag);
+                it.ok = true;
+            }
+            if (m > first) gcm_batch_flush(gkey, items + first, m - first, decrypt);
+            first = m + 1;
+            blocks = 0;
+            continue;
+        }
+        if (blocks + need > SM4_MODE_CHUNK) {
+            gcm_batch_flush(gkey, items + first, m - first, decrypt);
+            first = m;
+            blocks = 0;
+        }
+        blocks += need;
+    }
+    if (n > first) gcm_batch_flush(gkey, items + first, n - first, decrypt);
+}
+
+inline void sm4_gcm_encrypt_batch(const Sm4GcmKey& gkey, Sm4GcmBatchItem* items, size_t n) {
+    gcm_crypt_batch(gkey, items, n, false);
+}
+
+// 返回全部记录是否都通过认证，逐条结果见 items[i].ok
+inline bool sm4_gcm_decrypt_batch(const Sm4GcmKey& gkey, Sm4GcmBatchItem* items, size_t n) {
+    gcm_crypt_batch(gkey, items, n, true);
+    bool all = true;
+    for (size_t m = 0; m < n; ++m) all = all && items[m].ok;
+    return all;
+}
+
+// ---------------------------
+// 密钥上下文缓存：密钥编号 -> 加解密轮密钥与 GHASH 表，容量固定，满时淘汰最久未使用的项。
+// 故障切换后大量会话同时建立时，用 warm 一次性装入一批密钥，未命中的部分用 sm4_key_expand_batch
+// 成组扩展，H 在多密钥通道中成组计算。不加锁，每个线程各用一个缓存或由调用方加锁。
+// ---------------------------
+struct Sm4KeyCacheEntry {
+    u64 id;
+    alignas(64) u32 rk_dec[32];
+    Sm4GcmKey key;          // 加密轮密钥、H 及其各次幂/查找表
+    int prev, next;         // LRU 链表，prev 方向为更近使用
+};
+
+struct Sm4KeyCache {
+    std::vector<Sm4KeyCacheEntry> slots;
+    std::vector<int> free_slots;    // erase 空出的槽位，装入新密钥时优先使用
+    std::unordered_map<u64, int> index;
+    size_t capacity;
+    int head = -1, tail = -1;   // head 为最近使用，tail 为下一个被淘汰的项
+    u64 hits = 0, misses = 0, evictions = 0;
+
+    // 槽位一次分配好，之后不再搬迁（erase 只把槽位放回空闲表），get/find 返回的地址
+    // 在该项被淘汰或 erase 之前一直有效
+    explicit Sm4KeyCache(size_t cap) : capacity(cap ? cap : 1) {
+        slots.reserve(capacity);
+        index.reserve(capacity);
+    }
+
+    size_t size() const { return slots.size() - free_slots.size(); }
+
+    // 命中时移到链表头并返回，否则返回 nullptr；都计入统计
+    const Sm4KeyCacheEntry* find(u64 id) {
+        auto it = index.find(id);
+        if (it == index.end()) {
+            ++misses;
+            return nullptr;
+        }
+        ++hits;
+        touch(it->second);
+        return &slots[it->second];
+    }
+
+    // 取 id 对应的上下文，未命中时由 key 扩展并装入。容量已满时装入会淘汰最久未使用的项，
+    // 之前返回的该项引用随之失效
+    const Sm4KeyCacheEntry& get(u64 id, const u8 key[16]) {
+        if (const Sm4KeyCacheEntry* e = find(id)) return *e;
+        u32 rk[32], rk_dec[32];
+        sm4_key_expand_batch(key, 1, &rk, &rk_dec);
+        u8 zero[16] = { 0 }, H[16];
+        SM4_DISPATCH.encrypt_block(zero, H, rk);
+        return slots[insert(id, rk, rk_dec, H)];
+    }
+
+    // 预先装入 n 个密钥（keys 连续存放，每个 16 字节），已在缓存中的只更新使用顺序；
+    // 未命中的每凑满 16 个成组处理：轮密钥每 8 个一组扩展，16 个 H = E_k(0) 由多密钥内核一次算出
+    // （多密钥内核只有 T 表后备时逐个经 encrypt_block），GHASH 表只构造所选内核用到的。
+    // 返回新装入的个数。n 超过容量时较早装入的会被淘汰
+    size_t warm(const u64* ids, const u8* keys, size_t n) {
+        SM4_LANE_DISPATCH.init();
+        const sm4_lanes_fn lanes = SM4_LANE_DISPATCH.kernel->fn;
+        size_t added = 0, i = 0;
+        while (i < n) {
+            size_t miss[SM4_LANES], nm = 0;
+            u8 miss_keys[SM4_LANES * 16];
+            for (; i < n && nm < SM4_LANES; ++i) {
+                auto it = index.find(ids[i]);
+                if (it != index.end()) {
+                    ++hits;
+                    touch(it->second);
+                    continue;
+                }
+                bool dup = false;
+                for (size_t m = 0; m < nm; ++m) dup = dup || ids[miss[m]] == ids[i];
+                if (dup) continue;
+                ++misses;
+                memcpy(miss_keys + 16 * nm, keys + 16 * i, 16);
+                miss[nm++] = i;
+            }
+            if (nm == 0) continue;
+            alignas(64) u32 rk[SM4_LANES][32], rk_dec[SM4_LANES][32];
+            sm4_key_expand_batch(miss_keys, nm, rk, rk_dec);
+            alignas(64) u8 zero[16 * SM4_LANES] = { 0 }, H[16 * SM4_LANES];
+            if (lanes != sm4_encrypt_16lanes_ttable) {
+                Sm4LaneKeys lk;
+                for (int l = 0; l < SM4_LANES; ++l) lk.set_lane(l, rk[(size_t)l < nm ? l : 0]);
+                lanes(zero, H, lk);
+            } else {
+                for (size_t m = 0; m < nm; ++m) SM4_DISPATCH.encrypt_block(zero, H + 16 * m, rk[m]);
+            }
+            for (size_t m = 0; m < nm; ++m) insert(ids[miss[m]], rk[m], rk_dec[m], H + 16 * m);
+            added += nm;
+        }
+        return added;
+    }
+
+    // 密钥轮换或会话结束时移除：槽位内容清零后放回空闲表，其余项的地址不变
+    void erase(u64 id) {
+        auto it = index.find(id);
+        if (it == index.end()) return;
+        int s = it->second;
+        index.erase(it);
+        unlink(s);
+        gcm_secure_zero((u8*)&slots[s], sizeof(Sm4KeyCacheEntry));
+        free_slots.push_back(s);
+    }
+
+private:
+    void unlink(int s) {
+        Sm4KeyCacheEntry& e = slots[s];
+        if (e.prev >= 0) slots[e.prev].next = e.next; else head = e.next;
+        if (e.next >= 0) slots[e.next].prev = e.prev; else tail = e.prev;
+    }
+    void link_front(int s) {
+        slots[s].prev = -1;
+        slots[s].next = head;
+        if (head >= 0) slots[head].prev = s;
+        head = s;
+        if (tail < 0) tail = s;
+    }
+    void touch(int s) {
+        if (s == head) return;
+        unlink(s);
+        link_front(s);
+    }
+
+    int insert(u64 id, const u32 rk[32], const u32 rk_dec[32], const u8 H[16]) {
+        int s;
+        if (!free_slots.empty()) {
+            s = free_slots.back();
+            free_slots.pop_back();
+        } else if (slots.size() < capacity) {
+            slots.emplace_back();
+            s = (int)slots.size() - 1;
+        } else {
+            s = tail;
+            unlink(s);
+            index.erase(slots[s].id);
+            ++evictions;
+        }
+        Sm4KeyCacheEntry& e = slots[s];
+        e.id = id;
+        memcpy(e.rk_dec, rk_dec, sizeof(e.rk_dec));
+        e.key.init_rk_h(rk, H);
+        index[id] = s;
+        link_front(s);
+        return s;
+    }
+};
+
+// 每次调用都重新扩展密钥、计算 H，适合偶尔加密一条消息；同一密钥反复使用时应保留 Sm4GcmKey
+inline void sm4_gcm_encrypt(const u8 key[16], const u8 iv[12], const u8* plaintext, size_t plen,
+    const u8* aad, size_t aadlen,
+    u8* ciphertext, u8 tag_out[16])
+{
+    Sm4GcmKey gkey(key);
+    sm4_gcm_encrypt(gkey, iv, plaintext, plen, aad, aadlen, ciphertext, tag_out);
+}
+
+// ---------------------------
+// 超长消息的多线程 GCM：GHASH 是以 H 为自变量的多项式求值，
+//   X_n = X_0·H^n ^ B_1·H^n ^ B_2·H^(n-1) ^ ... ^ B_n·H，
+// 把 n 个分组切成 K 段，每段从 0 开始独立累加得到 Y_j，再按顺序合并 X <- X·H^(n_j) ^ Y_j
+// （n_j 为第 j 段的分组数），结果与逐块串行计算完全相同。CTR 部分各段从自己的起始计数器开始，
+// 与 sm4_ctr32_crypt_parallel 相同，因此一条消息的加解密与认证都能用满所有核。
+// ---------------------------
+static inline u128 gf128_mul(const u128& a, const u128& b) {
+    return (sm4_cpu_features() & SM4_CPU_PCLMUL) ? gfmul128_clmul(a, b) : gfmul128_slow(a, b);
+}
+
+// H^n，平方-乘；n = 0 时为乘法单位元（GCM 比特序下第 0 位为 1）
+inline u128 ghash_h_pow(const u128& H, u64 n) {
+    u128 r{ 1ULL << 63, 0 }, p = H;
+    for (; n; n >>= 1) {
+        if (n & 1) r = gf128_mul(r, p);
+        p = gf128_mul(p, p);
+    }
+    return r;
+}
+
+// 按顺序合并各段结果：X <- X·H^(n_j) ^ Y_j。各段长度一般相同，H 的幂只在长度变化时重新计算
+static void ghash_combine(u128& X, const u128& H, const u128* Y, const size_t* nblocks, unsigned parts) {
+    u64 cached_n = 0;
+    u128 Hn{ 1ULL << 63, 0 };
+    for (unsigned j = 0; j < parts; ++j) {
+        if (nblocks[j] == 0) continue;
+        if (nblocks[j] != cached_n) {
+            cached_n = nblocks[j];
+            Hn = ghash_h_pow(H, cached_n);
+        }
+        X = xor128(gf128_mul(X, Hn), Y[j]);
+    }
+}
+
+// 多线程吸收 nblocks 个分组，结果与 GHASH_DISPATCH.blocks 逐块串行相同
+inline void ghash_blocks_parallel(Sm4ThreadPool& pool, u128& X, const u8* data, size_t nblocks, const GhashKey& gk) {
+    unsigned parts = sm4_parallel_parts(pool, nblocks);
+    if (parts == 1) {
+        GHASH_DISPATCH.blocks(X, data, nblocks, gk);
+        return;
+    }
+    // run 在每个工作线程上都调用一次，序号不小于 parts 的段为空
+    std::vector<u128> Y(pool.size(), u128{ 0, 0 });
+    std::vector<size_t> n(pool.size(), 0);
+    std::function<void(unsigned)> fn = [&](unsigned i) {
+        size_t b, e;
+        sm4_partition(nblocks, parts, i, &b, &e);
+        n[i] = e - b;
+        if (b < e) GHASH_DISPATCH.blocks(Y[i], data + 16 * b, e - b, gk);
+    };
+    pool.run(fn);
+    ghash_combine(X, gk.H, Y.data(), n.data(), pool.size());
+}
+
+// 每段用一个 Sm4GcmCtx 走拼接循环：计数器前进到本段起点，GHASH 从 0 开始，只有最后一段可能
+// 有不足一块的尾部（补 0 吸收）。AAD 与长度块在调用线程上串行处理
+static void gcm_crypt_parallel(Sm4ThreadPool& pool, const Sm4GcmKey& gkey, const u8 iv[12], bool decrypt,
+    const u8* in, u8* out, size_t len, const u8* aad, size_t aadlen, u8 tag_out[16]) {
+    Sm4GcmCtx ctx;
+    ctx.init(gkey, iv, decrypt);
+    ctx.update_aad(aad, aadlen);
+    ctx.flush_partial();
+    size_t nblocks = (len + 15) / 16;
+    unsigned parts = sm4_parallel_parts(pool, nblocks);
+    if (parts == 1) {
+        ctx.update(in, out, len);
+        ctx.final(tag_out);
+        return;
+    }
+    // run 在每个工作线程上都调用一次，序号不小于 parts 的段为空
+    std::vector<u128> Y(pool.size(), u128{ 0, 0 });
+    std::vector<size_t> n(pool.size(), 0);
+    std::function<void(unsigned)> fn = [&](unsigned i) {
+        size_t b, e;
+        sm4_partition(nblocks, parts, i, &b, &e);
+        n[i] = e - b;
+        if (b == e) return;
+        size_t bytes = (16 * e < len ? 16 * e : len) - 16 * b;
+        Sm4GcmCtx seg;
+        seg.init(gkey, iv, decrypt);
+        seg.aad_done = true;
+        ctr32_add(seg.ctr, (u32)b);
+        seg.update(in + 16 * b, out + 16 * b, bytes);
+        seg.flush_partial();
+        Y[i] = seg.X;
+    };
+    pool.run(fn);
+    ghash_combine(ctx.X, gkey.gk.H, Y.data(), n.data(), pool.size());
+    ctx.aad_done = true;
+    ctx.text_len = len;
+    ctx.final(tag_out);
+}
+
+// 与 sm4_gcm_encrypt 结果逐字节相同；消息较短（每个线程不足 SM4_PARALLEL_MIN_BLOCKS 块）时由调用线程处理
+inline void sm4_gcm_encrypt_parallel(Sm4ThreadPool& pool, const Sm4GcmKey& gkey, const u8 iv[12], const u8* plaintext, size_t plen,
+    const u8* aad, size_t aadlen, u8* ciphertext, u8 tag_out[16]) {
+    gcm_crypt_parallel(pool, gkey, iv, false, plaintext, ciphertext, plen, aad, aadlen, tag_out);
+}
+
+// 认证失败时返回 false 并清零 plaintext，与 sm4_gcm_decrypt 一致
+inline bool sm4_gcm_decrypt_parallel(Sm4ThreadPool& pool, const Sm4GcmKey& gkey, const u8 iv[12], const u8* ciphertext, size_t clen,
+    const u8* aad, size_t aadlen, const u8 tag[16], u8* plaintext) {
+    u8 t[16];
+    gcm_crypt_parallel(pool, gkey, iv, true, ciphertext, plaintext, clen, aad, aadlen, t);
+    if (gcm_tag_equal(t, tag, 16)) return true;
+    gcm_secure_zero(plaintext, clen);
+    return false;
+}
+
+// ---------------------------
+// 密钥流预取：低延迟 RPC 中每条连接的 IV 由消息序号决定（与 RFC 8446 相同，12 字节基础 IV 的
+// 后 8 字节异或 64 位大端序号），之后若干条消息的 J0 与计数器分组事先可知。空闲时调用 fill，
+// 或用 start 启动后台线程，把后 N 条消息的密钥流（E(J0) 与 E(inc32(J0)) 起的计数器分组）算进
+// 环形缓冲区；小消息的加解密只剩异或与 GHASH。缓冲区耗尽或消息超过槽位长度时按需计算。
+// ---------------------------
+// 第 seq 条消息的 IV
+static inline void gcm_seq_iv(const u8 iv0[12], u64 seq, u8 iv[12]) {
+    memcpy(iv, iv0, 12);
+    for (int b = 0; b < 8; ++b) iv[11 - b] ^= (u8)(seq >> (8 * b));
+}
+
+struct Sm4KeystreamStats {
+    u64 hits;           // 使用预取密钥流的消息数
+    u64 misses;         // 对应槽位尚未算好、按需计算的消息数
+    u64 oversize;       // 超过槽位长度、按需计算的消息数
+    u64 generated;      // 已生成的槽位数（被按需计算越过的槽位不会再被使用）
+
+    double hit_rate() const {
+        u64 total = hits + misses + oversize;
+        return total ? (double)hits / total : 0.0;
+    }
+};
+
+// 一个对象对应连接的一个方向（发送端用 encrypt，接收端用 decrypt），消息按序号顺序处理。
+// encrypt / decrypt 只能由一个线程调用；fill 可以在该线程空闲时调用，也可以与后台线程同时存在。
+// 第 seq 条消息占用槽位 seq % slots，生成方只填写 [next_seq, next_seq + slots) 范围内的序号，
+// 槽位的 ready 写入 seq + 1 后才对使用方可见，使用方处理完一条消息后 next_seq 才前进，
+// 因此正在使用的槽位不会被改写；每个序号的密钥流最多使用一次。序号不能回绕（回绕即 IV 重复），
+// 连接应在此之前换密钥。
+struct Sm4GcmKeystreamRing {
+    const Sm4GcmKey& gkey;
+    u8 iv0[12];
+    const size_t slots;
+    const size_t slot_len;          // 每条消息最多可预取的字节数（16 的倍数）
+    const size_t slot_blocks;       // 1 + slot_len / 16：E(J0) 与计数器分组
+    std::vector<u8> ks;
+    std::vector<std::atomic<u64>> ready;    // 槽位中密钥流对应的序号 + 1，0 表示空
+    std::atomic<u64> next_seq;              // 下一条消息的序号，只由使用方前进
+    std::atomic<u64> filled;                // 生成方已填到的序号（不含），只在 fill_mtx 下前进
+    std::atomic<u64> hits{ 0 }, misses{ 0 }, oversize{ 0 }, generated{ 0 };
+    std::mutex fill_mtx;
+
+    // 后台线程：缓冲区空出至少 batch 个槽位时被唤醒，一次补 batch 个，计数器分组拼在一起
+    // 交给多分组内核
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<bool> sleeping{ false };
+    bool stop = false;
+    size_t batch = 0;
+
+    Sm4GcmKeystreamRing(const Sm4GcmKey& key, const u8 iv[12], size_t nslots = 64, size_t max_len = 1024, u64 first_seq = 0)
+        : gkey(key), slots(nslots ? nslots : 1), slot_len((max_len + 15) / 16 * 16), slot_blocks(1 + slot_len / 16),
+          ks(slots * slot_blocks * 16), ready(slots), next_seq(first_seq), filled(first_seq) {
+        memcpy(iv0, iv, 12);
+        for (auto& r : ready) r.store(0, std::memory_order_relaxed);
+    }
+
+    ~Sm4GcmKeystreamRing() { stop_background(); }
+
+    Sm4GcmKeystreamRing(const Sm4GcmKeystreamRing&) = delete;
+    Sm4GcmKeystreamRing& operator=(const Sm4GcmKeystreamRing&) = delete;
+
+    // 已算好、尚未使用的槽位数（近似值，只用于统计与调度）
+    size_t buffered() const {
+        u64 f = filled.load(), h = next_seq.load();
+        return f > h ? (size_t)(f - h) : 0;
+    }
+
+    // 最多补 max_slots 个槽位，返回实际补的数量；缓冲区已满时返回 0。
+    // 连续的槽位在密钥流缓冲区中也连续，一次最多拼 SM4_MODE_CHUNK 个分组交给 sm4_encrypt_blocks
+    size_t fill(size_t max_slots = (size_t)-1) {
+        std::lock_guard<std::mutex> lock(fill_mtx);
+        size_t done = 0;
+        while (done < max_slots) {
+            u64 head = next_seq.load();
+            u64 f = filled.load(std::memory_order_relaxed);
+            if (f < head) f = head;     // 使用方已按需越过的序号不再生成
+            u64 room = head + slots - f;
+            if (room == 0) break;
+            size_t first = (size_t)(f % slots);
+            size_t n = slots - first;
+            if (room < n) n = (size_t)room;
+            if (max_slots - done < n) n = max_slots - done;
+            size_t per = SM4_MODE_CHUNK / slot_blocks;
+            if (per == 0) per = 1;
+            if (per < n) n = per;
+            u8* p = ks.data() + first * slot_blocks * 16;
+            for (size_t k = 0; k < n; ++k) {
+                u8 ctr[16];
+                gcm_seq_iv(iv0, f + k, ctr);
+                ctr[12] = 0; ctr[13] = 0; ctr[14] = 0; ctr[15] = 1;
+                ctr32_fill(p + k * slot_blocks * 16, ctr, slot_blocks);
+            }
+            sm4_encrypt_blocks(p, p, n * slot_blocks, gkey.rk);
+            for (size_t k = 0; k < n; ++k) ready[first + k].store(f + k + 1, std::memory_order_release);
+            filled.store(f + n);
+            generated.fetch_add(n, std::memory_order_relaxed);
+            done += n;
+        }
+        return done;
+    }
+
+    void start_background(size_t refill_batch = 8) {
+        if (worker.joinable()) return;
+        batch = refill_batch ? (refill_batch < slots ? refill_batch : slots) : 1;
+        stop = false;
+        worker = std::thread([this] { background_main(); });
+    }
+
+    void stop_background() {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    // 加密第 next_seq 条消息并返回其序号（随记录发送，接收端据此检查顺序）
+    u64 encrypt(const u8* aad, size_t aadlen, const u8* plaintext, u8* ciphertext, size_t len, u8 tag_out[16]) {
+        u64 seq = next_seq.load(std::memory_order_relaxed);
+        const u8* s = take(seq, len);
+        if (s) {
+            xor_bytes(ciphertext, plaintext, s + 16, len);
+            u128 X = gcm_ghash_message(gkey.gk, aad, aadlen, ciphertext, len);
+            gcm_mask_tag(s, X, tag_out);
+        } else {
+            u8 iv[12];
+            gcm_seq_iv(iv0, seq, iv);
+            sm4_gcm_encrypt(gkey, iv, plaintext, len, aad, aadlen, ciphertext, tag_out);
+        }
+        release(seq);
+        return seq;
+    }
+
+    // 解密第 next_seq 条消息；认证失败时返回 false 并清零 plaintext，序号照常前进
+    bool decrypt(const u8* aad, size_t aadlen, const u8* ciphertext, u8* plaintext, size_t len, const u8 tag[16]) {
+        u64 seq = next_seq.load(std::memory_order_relaxed);
+        const u8* s = take(seq, len);
+        bool ok;
+        if (s) {
+            u128 X = gcm_ghash_message(gkey.gk, aad, aadlen, ciphertext, len);
+            u8 t[16];
+            gcm_mask_tag(s, X, t);
+            ok = gcm_tag_equal(t, tag, 16);
+            if (ok) xor_bytes(plaintext, ciphertext, s + 16, len);
+            else gcm_secure_zero(plaintext, len);
+        } else {
+            u8 iv[12];
+            gcm_seq_iv(iv0, seq, iv);
+            ok = sm4_gcm_decrypt(gkey, iv, ciphertext, len, aad, aadlen, tag, plaintext);
+        }
+        release(seq);
+        return ok;
+    }
+
+    Sm4KeystreamStats stats() const {
+        return { hits.load(), misses.load(), oversize.load(), generated.load() };
+    }
+
+    // 第 seq 条消息的预取密钥流（[0, 16) 为 E(J0)），未命中时返回 nullptr 并计入统计
+    const u8* take(u64 seq, size_t len) {
+        if (len > slot_len) {
+            oversize.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        size_t i = (size_t)(seq % slots);
+        if (ready[i].load(std::memory_order_acquire) != seq + 1) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return ks.data() + i * slot_blocks * 16;
+    }
+
+    // 先公布 next_seq 再检查 sleeping，后台线程先置 sleeping 再检查空位，两边至少有一方看到对方，
+    // 不会丢失唤醒；后台线程在忙时使用方不碰锁
+    void release(u64 seq) {
+        next_seq.store(seq + 1);
+        if (sleeping.load() && room() >= batch) {
+            std::lock_guard<std::mutex> lock(mtx);
+            cv.notify_one();
+        }
+    }
+
+    size_t room() const {
+        u64 f = filled.load(), h = next_seq.load();
+        if (f < h) f = h;
+        return (size_t)(h + slots - f);
+    }
+
+    static void gcm_mask_tag(const u8 ej0[16], const u128& X, u8 t[16]) {
+        for (int k = 0; k < 8; ++k) t[k] = ej0[k] ^ (u8)(X.hi >> (56 - 8 * k));
+        for (int k = 0; k < 8; ++k) t[8 + k] = ej0[8 + k] ^ (u8)(X.lo >> (56 - 8 * k));
+    }
+
+    void background_main() {
+        for (;;) {
+            fill(batch);
+            std::unique_lock<std::mutex> lock(mtx);
+            sleeping.store(true);
+            cv.wait(lock, [this] { return stop || room() >= batch; });
+            sleeping.store(false);
+            if (stop) return;
+        }
+    }
+};
@@ -0,0 +1,223 @@
+// 多密钥 SIMD SM4：每个 SIMD 通道使用自己的轮密钥。
+// 普通多分组内核把 rk[r] 广播到所有通道，只有同一密钥下的连续分组才能凑满一批；多租户网关中
+// 相邻记录往往属于不同租户。这里把最多 16 个密钥的轮密钥转置为 SoA 布局（第 r 轮的 16 个轮密钥
+// 连续存放），轮循环中每轮载入一个向量代替广播，16 个分组可以分别属于 16 个不同的密钥。
+#pragma once
+#include "sm4.h"
+
+static const int SM4_LANES = 16;
+
+// SoA 轮密钥：rk[r][i] 为第 i 个通道第 r 轮的轮密钥。通道 i 对应内核输入中的第 i 个分组，
+// 与 sm4_avx2_load8 / sm4_avx512_load16 转置后字向量中第 i 个 32 位元素的位置一致
+struct Sm4LaneKeys {
+    alignas(64) u32 rk[32][SM4_LANES];
+
+    void set_lane(int i, const u32 key_rk[32]) {
+        for (int r = 0; r < 32; ++r) rk[r][i] = key_rk[r];
+    }
+};
+
+typedef void (*sm4_lanes_fn)(const u8* in, u8* out, const Sm4LaneKeys& keys);
+
+// 后备实现：逐通道 T 表，直接按列读取 SoA 轮密钥
+inline void sm4_encrypt_16lanes_ttable(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    for (int i = 0; i < SM4_LANES; ++i, in += 16, out += 16) {
+        u32 X[4];
+        for (int w = 0; w < 4; ++w) X[w] = load_be32(in + 4 * w);
+        for (int r = 0; r < 32; ++r) {
+            u32 a = X[1] ^ X[2] ^ X[3] ^ keys.rk[r][i];
+            u32 t = TTABLE.T0[a >> 24] ^ TTABLE.T1[(a >> 16) & 0xFF] ^ TTABLE.T2[(a >> 8) & 0xFF] ^ TTABLE.T3[a & 0xFF];
+            u32 x = X[0] ^ t;
+            X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = x;
+        }
+        for (int w = 0; w < 4; ++w) {
+            u32 v = X[3 - w];
+            out[4 * w + 0] = (u8)(v >> 24);
+            out[4 * w + 1] = (u8)(v >> 16);
+            out[4 * w + 2] = (u8)(v >> 8);
+            out[4 * w + 3] = (u8)v;
+        }
+    }
+}
+
+// AVX2：16 个通道分两半各 8 块，每轮从 rk[r] + 8·half 载入 8 个轮密钥
+template<typename SBox>
+SM4_TARGET("avx2") void sm4_encrypt_16lanes_avx2_t(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    for (int half = 0; half < 2; ++half) {
+        __m256i X[4];
+        sm4_avx2_load8(in + 128 * half, X);
+        for (int r = 0; r < 32; ++r) {
+            __m256i k = _mm256_load_si256((const __m256i*)(keys.rk[r] + 8 * half));
+            __m256i t = _mm256_xor_si256(_mm256_xor_si256(X[(r + 1) & 3], X[(r + 2) & 3]),
+                _mm256_xor_si256(X[(r + 3) & 3], k));
+            X[r & 3] = _mm256_xor_si256(X[r & 3], SBox::T(t));
+        }
+        sm4_avx2_store8(out + 128 * half, X);
+    }
+}
+
+SM4_TARGET("avx2") inline void sm4_encrypt_16lanes_avx2_nibble(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    sm4_encrypt_16lanes_avx2_t<Sm4NibbleSbox>(in, out, keys);
+}
+
+SM4_TARGET("avx2,gfni") inline void sm4_encrypt_16lanes_avx2_gfni(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    for (int half = 0; half < 2; ++half) {
+        __m256i X[4];
+        sm4_avx2_load8(in + 128 * half, X);
+        for (int r = 0; r < 32; ++r) {
+            __m256i k = _mm256_load_si256((const __m256i*)(keys.rk[r] + 8 * half));
+            __m256i t = _mm256_xor_si256(_mm256_xor_si256(X[(r + 1) & 3], X[(r + 2) & 3]),
+                _mm256_xor_si256(X[(r + 3) & 3], k));
+            X[r & 3] = _mm256_xor_si256(X[r & 3], sm4_L_avx2(sm4_sbox_gfni_avx2(t)));
+        }
+        sm4_avx2_store8(out + 128 * half, X);
+    }
+}
+
+// AVX-512：一个 ZMM 正好 16 个通道，每轮一次 64 字节对齐载入
+SM4_TARGET("avx512f,avx512bw") inline void sm4_encrypt_16lanes_avx512_nibble(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    __m512i X[4];
+    sm4_avx512_load16(in, X);
+    for (int r = 0; r < 32; ++r) {
+        __m512i t = _mm512_ternarylogic_epi32(X[(r + 1) & 3], X[(r + 2) & 3], X[(r + 3) & 3], 0x96);
+        t = _mm512_xor_si512(t, _mm512_load_si512((const void*)keys.rk[r]));
+        X[r & 3] = _mm512_xor_si512(X[r & 3], sm4_L_avx512(sm4_sbox_nibble_avx512(t)));
+    }
+    sm4_avx512_store16(out, X);
+}
+
+SM4_TARGET("avx512f,avx512bw,gfni") inline void sm4_encrypt_16lanes_avx512_gfni(const u8* in, u8* out, const Sm4LaneKeys& keys) {
+    __m512i X[4];
+    sm4_avx512_load16(in, X);
+    for (int r = 0; r < 32; ++r) {
+        __m512i t = _mm512_ternarylogic_epi32(X[(r + 1) & 3], X[(r + 2) & 3], X[(r + 3) & 3], 0x96);
+        t = _mm512_xor_si512(t, _mm512_load_si512((const void*)keys.rk[r]));
+        X[r & 3] = _mm512_xor_si512(X[r & 3], sm4_L_avx512(sm4_sbox_gfni_avx512(t)));
+    }
+    sm4_avx512_store16(out, X);
+}
+
+struct Sm4LaneKernelInfo {
+    const char* name;   // 与 SM4_KERNELS 中对应的单密钥内核同名
+    u32 need;
+    sm4_lanes_fn fn;
+};
+
+static const Sm4LaneKernelInfo SM4_LANE_KERNELS[] = {
+    { "avx512-gfni", SM4_CPU_AVX512F | SM4_CPU_AVX512BW | SM4_CPU_GFNI, sm4_encrypt_16lanes_avx512_gfni },
+    { "avx2-gfni", SM4_CPU_AVX2 | SM4_CPU_GFNI, sm4_encrypt_16lanes_avx2_gfni },
+    { "avx512-nibble", SM4_CPU_AVX512F | SM4_CPU_AVX512BW, sm4_encrypt_16lanes_avx512_nibble },
+    { "avx2-nibble", SM4_CPU_AVX2, sm4_encrypt_16lanes_avx2_nibble },
+    { "ttable", 0, sm4_encrypt_16lanes_ttable },
+};
+
+// 16 个通道各用一个不同的密钥，与基础实现逐块比对
+inline bool sm4_lane_kernel_self_check(sm4_lanes_fn fn) {
+    Sm4LaneKeys keys;
+    u8 in[16 * SM4_LANES], ref[16 * SM4_LANES], out[16 * SM4_LANES];
+    for (int i = 0; i < SM4_LANES; ++i) {
+        u8 key[16];
+        u32 rk[32];
+        for (int j = 0; j < 16; ++j) key[j] = (u8)(i * 31 + j * 7 + 1);
+        sm4_key_expand(key, rk);
+        keys.set_lane(i, rk);
+        for (int j = 0; j < 16; ++j) in[16 * i + j] = (u8)(i * 13 + j * 5);
+        sm4_encrypt_block(in + 16 * i, ref + 16 * i, rk);
+    }
+    fn(in, out, keys);
+    return memcmp(ref, out, sizeof(ref)) == 0;
+}
+
+// 与 SM4_DISPATCH 选中的内核同名的多密钥内核（因此同样受 SM4_KERNEL 控制），
+// 没有对应版本时选本机支持且自检通过的第一个
+// 初值为不需要任何 CPU 特性的 ttable，init 由 call_once 保证只执行一次
+struct SM4_LANE_DISPATCH_TABLE {
+    std::once_flag once;
+    const Sm4LaneKernelInfo* kernel = &SM4_LANE_KERNELS[4];
+
+    void init() {
+        std::call_once(once, [this] {
+            SM4_DISPATCH.init();
+            const Sm4LaneKernelInfo* first = nullptr;
+            for (const Sm4LaneKernelInfo& k : SM4_LANE_KERNELS) {
+                if ((SM4_DISPATCH.cpu & k.need) != k.need || !sm4_lane_kernel_self_check(k.fn)) continue;
+                if (!first) first = &k;
+                if (strcmp(k.name, SM4_DISPATCH.kernel->name) == 0) {
+                    kernel = &k;
+                    return;
+                }
+            }
+            if (first) kernel = first;
+        });
+    }
+};
+inline SM4_LANE_DISPATCH_TABLE SM4_LANE_DISPATCH;
+
+// ---------------------------
+// 任务分组：把待处理的 (密钥, 分组序列) 任务装进通道
+// ---------------------------
+struct Sm4LaneJob {
+    const u32* rk;      // 32 个轮密钥（传解密轮密钥即为解密）
+    const u8* in;       // nblocks 个分组，可以与 out 相同
+    u8* out;
+    size_t nblocks;
+};
+
+// 每个任务中能凑满 SM4_DISPATCH 所选内核宽度的整组仍由单密钥内核处理，零头进入通道：每个通道
+// 持有一个任务并逐块前进，任务做完后按顺序接下一个任务；没有新任务时从剩余分组最多的通道拆走
+// 后一半。通道换密钥时才重写该列轮密钥（32 个字），同一任务在同一通道内连续处理时不再改动。
+// 各任务的缓冲区互不重叠；ECB、CTR（输入为计数器分组）等逐块独立的模式都可以用它。
+inline void sm4_encrypt_multikey(const Sm4LaneJob* jobs, size_t njobs) {
+    SM4_LANE_DISPATCH.init();
+    const sm4_lanes_fn fn = SM4_LANE_DISPATCH.kernel->fn;
+    const size_t W = (size_t)SM4_DISPATCH.multi_blocks;
+    struct Lane { const u32* rk; const u8* in; u8* out; size_t left; };
+    Lane lane[SM4_LANES] = {};
+    const u32* loaded[SM4_LANES] = {};
+    Sm4LaneKeys keys;
+    memset(&keys, 0, sizeof(keys));
+    alignas(64) u8 in[16 * SM4_LANES] = {}, out[16 * SM4_LANES];
+    size_t next = 0;
+    for (;;) {
+        int active = 0;
+        for (int i = 0; i < SM4_LANES; ++i) {
+            Lane& l = lane[i];
+            if (l.left == 0) {
+                while (next < njobs && jobs[next].nblocks == 0) ++next;
+                if (next < njobs) {
+                    const Sm4LaneJob& j = jobs[next++];
+                    l = { j.rk, j.in, j.out, j.nblocks };
+                    // 能凑满单密钥内核的整组直接交给它，只有零头进入通道
+                    for (; l.left >= W; l.left -= W, l.in += 16 * W, l.out += 16 * W)
+                        SM4_DISPATCH.encrypt_multi(l.in, l.out, l.rk);
+                    if (l.left == 0) {
+                        --i;
+                        continue;
+                    }
+                } else {
+                    // 拆走的是后一半，不含对方本轮已载入的那一块
+                    int v = 0;
+                    for (int k = 1; k < SM4_LANES; ++k) if (lane[k].left > lane[v].left) v = k;
+                    size_t take = lane[v].left / 2;
+                    if (take == 0) continue;
+                    lane[v].left -= take;
+                    l = { lane[v].rk, lane[v].in + 16 * lane[v].left, lane[v].out + 16 * lane[v].left, take };
+                }
+            }
+            if (loaded[i] != l.rk) {
+                keys.set_lane(i, l.rk);
+                loaded[i] = l.rk;
+            }
+            memcpy(in + 16 * i, l.in, 16);
+            ++active;
+        }
+        if (active == 0) break;
+        fn(in, out, keys);
+        for (int i = 0; i < SM4_LANES; ++i) {
+            Lane& l = lane[i];
+            if (l.left == 0) continue;
+            memcpy(l.out, out + 16 * i, 16);
+            l.in += 16; l.out += 16; --l.left;
+        }
+    }
+}
@@ -0,0 +1,207 @@
+// 多线程批量 SM4：常驻线程池 + 按计数器对齐切分的 CTR/ECB。
+// 线程在构造线程池时创建并绑定到各自的 CPU，之后每次调用只做一次唤醒与等待，不再创建线程。
+#pragma once
+#include "sm4.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+// 每个线程至少分到的分组数（64KB），数据更少时由调用线程直接处理，避免唤醒开销
+static const size_t SM4_PARALLEL_MIN_BLOCKS = 4096;
+
+struct Sm4ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv_start, cv_done;
+    const std::function<void(unsigned)>* job = nullptr;
+    u64 generation = 0;
+    unsigned pending = 0;
+    bool stop = false;
+
+    // nthreads 为 0 时取硬件线程数；pin 为 true 时第 i 个线程绑定到进程可用的第 i 个 CPU
+    explicit Sm4ThreadPool(unsigned nthreads = 0, bool pin = true) {
+        if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+        if (nthreads == 0) nthreads = 1;
+        std::vector<int> cpus = allowed_cpus();
+        for (unsigned i = 0; i < nthreads; ++i) {
+            workers.emplace_back([this, i] { worker_main(i); });
+            if (pin && !cpus.empty()) pin_thread(workers.back(), cpus[i % cpus.size()]);
+        }
+    }
+
+    ~Sm4ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv_start.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    Sm4ThreadPool(const Sm4ThreadPool&) = delete;
+    Sm4ThreadPool& operator=(const Sm4ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    // 每个工作线程执行一次 fn(i)，全部完成后返回；同一时刻只能有一个调用者
+    void run(const std::function<void(unsigned)>& fn) {
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &fn;
+        pending = size();
+        ++generation;
+        cv_start.notify_all();
+        cv_done.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+    void worker_main(unsigned id) {
+        u64 seen = 0;
+        for (;;) {
+            const std::function<void(unsigned)>* fn;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_start.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                fn = job;
+            }
+            (*fn)(id);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--pending == 0) cv_done.notify_one();
+        }
+    }
+
+    // 进程亲和性掩码中的 CPU 编号，按编号升序；同一 NUMA 节点的 CPU 通常编号相邻
+    static std::vector<int> allowed_cpus() {
+        std::vector<int> cpus;
+#if defined(_WIN32)
+        DWORD_PTR proc_mask = 0, sys_mask = 0;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &proc_mask, &sys_mask)) {
+            for (int c = 0; c < (int)(8 * sizeof(DWORD_PTR)); ++c)
+                if (proc_mask & ((DWORD_PTR)1 << c)) cpus.push_back(c);
+        }
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; ++c)
+                if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+#endif
+        return cpus;
+    }
+
+    static void pin_thread(std::thread& t, int cpu) {
+#if defined(_WIN32)
+        SetThreadAffinityMask((HANDLE)t.native_handle(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+        (void)t; (void)cpu;
+#endif
+    }
+};
+
+// 把 nblocks 个分组切成 parts 段，段边界按 SM4_MODE_CHUNK（256 块 = 4KB）对齐，
+// 缓冲区按页对齐时每一页只属于一个线程；第 i 段为 [*begin, *end)，可能为空
+static inline void sm4_partition(size_t nblocks, unsigned parts, unsigned i, size_t* begin, size_t* end) {
+    size_t units = (nblocks + SM4_MODE_CHUNK - 1) / SM4_MODE_CHUNK;
+    size_t per = (units + parts - 1) / parts * SM4_MODE_CHUNK;
+    size_t b = per * i, e = per * (i + 1);
+    *begin = b < nblocks ? b : nblocks;
+    *end = e < nblocks ? e : nblocks;
+}
+
+// 参与计算的线程数：每个线程至少 SM4_PARALLEL_MIN_BLOCKS 个分组
+static inline unsigned sm4_parallel_parts(const Sm4ThreadPool& pool, size_t nblocks) {
+    size_t parts = nblocks / SM4_PARALLEL_MIN_BLOCKS;
+    if (parts > pool.size()) parts = pool.size();
+    return parts ? (unsigned)parts : 1;
+}
+
+// 多线程 CTR，计数器语义与 sm4_gcm_encrypt 的 inc32 完全相同：第 k 个分组的计数器为
+// ctr0 的低 32 位加 k（模 2^32），前 12 字节不变。每段从自己的起始计数器开始，结果与单线程一致
+inline void sm4_ctr32_crypt_parallel(Sm4ThreadPool& pool, const u8 ctr0[16], const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    SM4_DISPATCH.init();
+    size_t nblocks = (len + 15) / 16;
+    unsigned parts = sm4_parallel_parts(pool, nblocks);
+    if (parts == 1) {
+        sm4_ctr32_crypt(ctr0, in, out, len, rk);
+        return;
+    }
+    std::function<void(unsigned)> fn = [&](unsigned i) {
+        size_t b, e;
+        sm4_partition(nblocks, parts, i, &b, &e);
+        if (b == e) return;
+        size_t bytes = (16 * e < len ? 16 * e : len) - 16 * b;
+        u8 ctr[16];
+        memcpy(ctr, ctr0, 16);
+        ctr32_add(ctr, (u32)b);
+        sm4_ctr32_crypt(ctr, in + 16 * b, out + 16 * b, bytes, rk);
+    };
+    pool.run(fn);
+}
+
+// 多线程 ECB：rk 传加密轮密钥即加密，传 sm4_key_expand_dec 的结果即解密；长度须为 16 的倍数
+inline bool sm4_ecb_crypt_parallel(Sm4ThreadPool& pool, const u8* in, u8* out, size_t len, const u32 rk[32]) {
+    if (len % 16) return false;
+    SM4_DISPATCH.init();
+    size_t nblocks = len / 16;
+    unsigned parts = sm4_parallel_parts(pool, nblocks);
+    if (parts == 1) {
+        sm4_encrypt_blocks(in, out, nblocks, rk);
+        return true;
+    }
+    std::function<void(unsigned)> fn = [&](unsigned i) {
+        size_t b, e;
+        sm4_partition(nblocks, parts, i, &b, &e);
+        if (b < e) sm4_encrypt_blocks(in + 16 * b, out + 16 * b, e - b, rk);
+    };
+    pool.run(fn);
+    return true;
+}
+
+// NUMA 本地缓冲区：按页分配但不在调用线程上访问，由各工作线程按 sm4_partition 的划分
+// 各自先写一遍。操作系统按首次访问（first-touch）把页面放在访问线程所在的节点上，
+// 之后用同一个线程池处理这块缓冲区时，每个线程读写的都是本节点内存。
+inline u8* sm4_parallel_alloc(Sm4ThreadPool& pool, size_t len) {
+    if (len == 0) return nullptr;
+#if defined(_WIN32)
+    u8* p = (u8*)VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!p) return nullptr;
+#else
+    void* m = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) return nullptr;
+    u8* p = (u8*)m;
+#endif
+    size_t nblocks = (len + 15) / 16;
+    unsigned parts = sm4_parallel_parts(pool, nblocks);
+    std::function<void(unsigned)> fn = [&](unsigned i) {
+        size_t b, e;
+        sm4_partition(nblocks, parts, i, &b, &e);
+        if (b < e) memset(p + 16 * b, 0, (16 * e < len ? 16 * e : len) - 16 * b);
+    };
+    pool.run(fn);
+    return p;
+}
+
+inline void sm4_parallel_free(u8* p, size_t len) {
+    if (!p) return;
+#if defined(_WIN32)
+    (void)len;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, len);
+#endif
+}
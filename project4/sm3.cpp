@@ -1,247 +1,530 @@
-#include <iostream>
-#include <vector>
-#include <cstdint>
-#include <chrono>
-#include <iomanip>
-
-using namespace std;
-using namespace chrono;
-
-// 
-const uint32_t IV[8] = {
-    0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
-    0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
-};
-
-const uint32_t T[64] = {
-    0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519,
-    0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
-    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A
-};
-
-// 
-uint32_t ROTL32(uint32_t x, int n) {
-    n &= 31;
-    return (x << n) | (x >> (32 - n));
-}
-
-uint32_t P0(uint32_t x) {
-    return x ^ ROTL32(x, 9) ^ ROTL32(x, 17);
-}
-
-uint32_t P1(uint32_t x) {
-    return x ^ ROTL32(x, 15) ^ ROTL32(x, 23);
-}
-
-uint32_t FF(uint32_t x, uint32_t y, uint32_t z, int j) {
-    if (j < 16) return x ^ y ^ z;
-    else return (x & y) | (x & z) | (y & z);
-}
-
-uint32_t GG(uint32_t x, uint32_t y, uint32_t z, int j) {
-    if (j < 16) return x ^ y ^ z;
-    else return (x & y) | ((~x) & z);
-}
-
-// ׼SM3ʵ
-vector<uint8_t> sm3_standard(const vector<uint8_t>& msg) {
-    // 1. Ϣ
-    size_t l = msg.size() * 8;
-    vector<uint8_t> m = msg;
-    m.push_back(0x80);  // 1
-
-    while ((m.size() * 8) % 512 != 448) {
-        m.push_back(0x00);  // 0
-    }
-
-    // ӳϢСתˣ
-    for (int i = 7; i >= 0; --i) {
-        m.push_back((l >> (i * 8)) & 0xFF);
-    }
-
-    // 2. ʼϣֵ
-    uint32_t V[8];
-    memcpy(V, IV, 8 * sizeof(uint32_t));
-
-    // 3. ÿ512ط
-    for (size_t i = 0; i < m.size(); i += 64) {
-        // 3.1 Ϣչ
-        uint32_t W[68], W1[64];
-        for (int j = 0; j < 16; ++j) {
-            W[j] = (m[i + 4 * j] << 24) | (m[i + 4 * j + 1] << 16) |
-                (m[i + 4 * j + 2] << 8) | m[i + 4 * j + 3];
-        }
-
-        for (int j = 16; j < 68; ++j) {
-            W[j] = P1(W[j - 16] ^ W[j - 9] ^ ROTL32(W[j - 3], 15)) ^
-                ROTL32(W[j - 13], 7) ^ W[j - 6];
-        }
-
-        for (int j = 0; j < 64; ++j) {
-            W1[j] = W[j] ^ W[j + 4];
-        }
-
-        // 3.2 ѹ
-        uint32_t A = V[0], B = V[1], C = V[2], D = V[3];
-        uint32_t E = V[4], F = V[5], G = V[6], H = V[7];
-
-        for (int j = 0; j < 64; ++j) {
-            uint32_t SS1 = ROTL32(ROTL32(A, 12) + E + ROTL32(T[j], j), 7);
-            uint32_t SS2 = SS1 ^ ROTL32(A, 12);
-            uint32_t TT1 = FF(A, B, C, j) + D + SS2 + W1[j];
-            uint32_t TT2 = GG(E, F, G, j) + H + SS1 + W[j];
-
-            D = C;
-            C = ROTL32(B, 9);
-            B = A;
-            A = TT1;
-            H = G;
-            G = ROTL32(F, 19);
-            F = E;
-            E = P0(TT2);
-        }
-
-        // 3.3 ¹ϣֵ
-        V[0] ^= A;
-        V[1] ^= B;
-        V[2] ^= C;
-        V[3] ^= D;
-        V[4] ^= E;
-        V[5] ^= F;
-        V[6] ^= G;
-        V[7] ^= H;
-    }
-
-    // 4. ϣֵˣ
-    vector<uint8_t> digest(32);
-    for (int i = 0; i < 8; ++i) {
-        digest[4 * i] = (V[i] >> 24) & 0xFF;
-        digest[4 * i + 1] = (V[i] >> 16) & 0xFF;
-        digest[4 * i + 2] = (V[i] >> 8) & 0xFF;
-        digest[4 * i + 3] = V[i] & 0xFF;
-    }
-    return digest;
-}
-
-// ŻSM3ʵ
-vector<uint8_t> sm3_optimized(const vector<uint8_t>& msg) {
-    // 1. Ϣ䣨ͬ׼ʵ֣
-    size_t l = msg.size() * 8;
-    vector<uint8_t> m = msg;
-    m.push_back(0x80);
-
-    while ((m.size() * 8) % 512 != 448) {
-        m.push_back(0x00);
-    }
-
-    for (int i = 7; i >= 0; --i) {
-        m.push_back((l >> (i * 8)) & 0xFF);
-    }
-
-    // 2. ʼϣֵ
-    uint32_t V[8];
-    memcpy(V, IV, 8 * sizeof(uint32_t));
-
-    // 3. ÿ512ط
-    for (size_t i = 0; i < m.size(); i += 64) {
-        // 3.1 ϢչŻʣ
-        uint32_t W[68], W1[64];
-        for (int j = 0; j < 16; ++j) {
-            W[j] = (m[i + 4 * j] << 24) | (m[i + 4 * j + 1] << 16) |
-                (m[i + 4 * j + 2] << 8) | m[i + 4 * j + 3];
-        }
-
-        // Żʹþֲ泣ֵ
-        for (int j = 16; j < 68; ++j) {
-            const uint32_t w16 = W[j - 16];
-            const uint32_t w9 = W[j - 9];
-            const uint32_t w3 = ROTL32(W[j - 3], 15);
-            const uint32_t w13 = ROTL32(W[j - 13], 7);
-            const uint32_t w6 = W[j - 6];
-            W[j] = P1(W[j - 16] ^ W[j - 9] ^ ROTL32(W[j - 3], 15)) ^ ROTL32(W[j - 13], 7) ^ W[j - 6];
-        }
-
-        for (int j = 0; j < 64; ++j) {
-            W1[j] = W[j] ^ W[j + 4];
-        }
-
-        // 3.2 ѹŻ4ֺϲ
-        uint32_t A = V[0], B = V[1], C = V[2], D = V[3];
-        uint32_t E = V[4], F = V[5], G = V[6], H = V[7];
-
-        // 궨4ϲ
-#define ROUND(j) \
-            SS1 = ROTL32(ROTL32(A, 12) + E + ROTL32(T[j], j), 7); \
-            SS2 = SS1 ^ ROTL32(A, 12); \
-            TT1 = FF(A, B, C, j) + D + SS2 + W1[j]; \
-            TT2 = GG(E, F, G, j) + H + SS1 + W[j]; \
-            D = C; C = ROTL32(B, 9); B = A; A = TT1; \
-            H = G; G = ROTL32(F, 19); F = E; E = P0(TT2);
-
-        // 64֣ÿ4һ飩
-        for (int j = 0; j < 64; ) {
-            uint32_t SS1, SS2, TT1, TT2;
-            ROUND(j++);
-            ROUND(j++);
-            ROUND(j++);
-            ROUND(j++);
-        }
-#undef ROUND
-
-        // 3.3 ¹ϣֵ
-        V[0] ^= A; V[1] ^= B; V[2] ^= C; V[3] ^= D;
-        V[4] ^= E; V[5] ^= F; V[6] ^= G; V[7] ^= H;
-    }
-
-    // 4. ϣֵ
-    vector<uint8_t> digest(32);
-    for (int i = 0; i < 8; ++i) {
-        digest[4 * i] = (V[i] >> 24) & 0xFF;
-        digest[4 * i + 1] = (V[i] >> 16) & 0xFF;
-        digest[4 * i + 2] = (V[i] >> 8) & 0xFF;
-        digest[4 * i + 3] = V[i] & 0xFF;
-    }
-    return digest;
-}
-
-// Ժ
-void benchmark() {
-    // 1MB
-    const size_t DATA_SIZE = 1024 * 1024;
-    vector<uint8_t> data(DATA_SIZE, 0xAA);  // 
-
-    // ׼ʵֲ
-    auto start = high_resolution_clock::now();
-    auto hash1 = sm3_standard(data);
-    auto end = high_resolution_clock::now();
-    double time_std = duration<double, milli>(end - start).count();
-    double throughput_std = (DATA_SIZE / 1024.0 / 1024.0) / (time_std / 1000.0);
-
-    // Żʵֲ
-    start = high_resolution_clock::now();
-    auto hash2 = sm3_optimized(data);
-    end = high_resolution_clock::now();
-    double time_opt = duration<double, milli>(end - start).count();
-    double throughput_opt = (DATA_SIZE / 1024.0 / 1024.0) / (time_opt / 1000.0);
-
-    // 
-    cout << "=== SM3ЧʶԱȲ ===" << endl;
-    cout << "ݴС: " << DATA_SIZE / 1024 << "KB" << endl;
-    cout << "׼ʵ: " << fixed << setprecision(2)
-        << time_std << "ms, : " << throughput_std << "MB/s" << endl;
-    cout << "Żʵ: " << fixed << setprecision(2)
-        << time_opt << "ms, : " << throughput_opt << "MB/s" << endl;
-    cout << "Ż: " << fixed << setprecision(2) << (throughput_opt / throughput_std) << "x" << endl;
-
-    
-}
-
-int main() {
-    benchmark();
-    return 0;
+#include <iostream>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <immintrin.h>
+#include "sm3.h"
+
+using namespace std;
+using namespace chrono;
+
+// 标准SM3实现
+vector<uint8_t> sm3_standard(const vector<uint8_t>& msg) {
+    // 1. 消息填充
+    size_t l = msg.size() * 8;
+    vector<uint8_t> m = msg;
+    m.push_back(0x80);  // 添加1比特
+
+    while ((m.size() * 8) % 512 != 448) {
+        m.push_back(0x00);  // 填充0
+    }
+
+    // 添加长度信息（小端转大端）
+    for (int i = 7; i >= 0; --i) {
+        m.push_back((l >> (i * 8)) & 0xFF);
+    }
+
+    // 2. 初始化哈希值
+    uint32_t V[8];
+    memcpy(V, IV, 8 * sizeof(uint32_t));
+
+    // 3. 处理每个512比特分组
+    for (size_t i = 0; i < m.size(); i += 64) {
+        // 3.1 消息扩展
+        uint32_t W[68], W1[64];
+        for (int j = 0; j < 16; ++j) {
+            W[j] = (m[i + 4 * j] << 24) | (m[i + 4 * j + 1] << 16) |
+                (m[i + 4 * j + 2] << 8) | m[i + 4 * j + 3];
+        }
+
+        for (int j = 16; j < 68; ++j) {
+            W[j] = P1(W[j - 16] ^ W[j - 9] ^ ROTL32(W[j - 3], 15)) ^
+                ROTL32(W[j - 13], 7) ^ W[j - 6];
+        }
+
+        for (int j = 0; j < 64; ++j) {
+            W1[j] = W[j] ^ W[j + 4];
+        }
+
+        // 3.2 迭代压缩
+        uint32_t A = V[0], B = V[1], C = V[2], D = V[3];
+        uint32_t E = V[4], F = V[5], G = V[6], H = V[7];
+
+        for (int j = 0; j < 64; ++j) {
+            uint32_t SS1 = ROTL32(ROTL32(A, 12) + E + ROTL32(T[j], j), 7);
+            uint32_t SS2 = SS1 ^ ROTL32(A, 12);
+            uint32_t TT1 = FF(A, B, C, j) + D + SS2 + W1[j];
+            uint32_t TT2 = GG(E, F, G, j) + H + SS1 + W[j];
+
+            D = C;
+            C = ROTL32(B, 9);
+            B = A;
+            A = TT1;
+            H = G;
+            G = ROTL32(F, 19);
+            F = E;
+            E = P0(TT2);
+        }
+
+        // 3.3 更新哈希值
+        V[0] ^= A;
+        V[1] ^= B;
+        V[2] ^= C;
+        V[3] ^= D;
+        V[4] ^= E;
+        V[5] ^= F;
+        V[6] ^= G;
+        V[7] ^= H;
+    }
+
+    // 4. 输出哈希值（大端）
+    vector<uint8_t> digest(32);
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = (V[i] >> 24) & 0xFF;
+        digest[4 * i + 1] = (V[i] >> 16) & 0xFF;
+        digest[4 * i + 2] = (V[i] >> 8) & 0xFF;
+        digest[4 * i + 3] = V[i] & 0xFF;
+    }
+    return digest;
+}
+
+// 优化版SM3实现：经 Sm3Ctx 直接压缩 msg，不再复制整条消息做填充
+vector<uint8_t> sm3_optimized(const vector<uint8_t>& msg) {
+    array<uint8_t, 32> d = sm3_digest(msg.data(), msg.size());
+    return vector<uint8_t>(d.begin(), d.end());
+}
+
+// ---------------------------
+// 多缓冲 SM3：一条消息的压缩是串行依赖链，单条消息用 SIMD 收益有限；大量互相独立的短消息
+// （Merkle 叶子、去重指纹、KDF 分组）则可以每个 SIMD 通道放一条消息的链接变量，64 轮对 8 个（AVX2）
+// 或 16 个（AVX-512）通道同时执行。状态按 SoA 存放：S[i][l] 为第 l 个通道的 V[i]。
+// ---------------------------
+static const int SM3_MB_LANES = 16;
+
+// 各轮的 T_j <<< j，与 sm3_compress_body 中 ROTL32(T[j], j) 相同
+struct SM3_TJ_TABLE {
+    uint32_t k[64];
+    SM3_TJ_TABLE() {
+        for (int j = 0; j < 64; ++j) k[j] = ROTL32(T[j], j);
+    }
+};
+static const SM3_TJ_TABLE SM3_TJ;
+
+// 8 个通道各自分组中 off 处的 32 字节：按大端读成 8 个字后转置，out[w] 的第 l 个元素为第 l 个通道的第 w 个字
+SM3_TARGET("avx2") static SM3_FORCEINLINE void sm3_load8x8_avx2(const uint8_t* const* p, int off, __m256i out[8]) {
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i r[8], t[8], u[8];
+    for (int l = 0; l < 8; ++l) r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(p[l] + off)), bswap);
+    for (int l = 0; l < 8; l += 2) {
+        t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+        t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+    }
+    for (int l = 0; l < 8; l += 4) {
+        u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+        u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+        u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+        u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    for (int w = 0; w < 4; ++w) {
+        out[w] = _mm256_permute2x128_si256(u[w], u[w + 4], 0x20);
+        out[w + 4] = _mm256_permute2x128_si256(u[w], u[w + 4], 0x31);
+    }
+}
+
+// 向量运算策略：XOR3 / MAJ / CH 分别对应 j < 16 时的 FF、GG 与 j >= 16 时的 FF、GG
+struct Sm3Avx2Ops {
+    typedef __m256i V;
+    static const int LANES = 8;
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V add(V a, V b) { return _mm256_add_epi32(a, b); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V x(V a, V b) { return _mm256_xor_si256(a, b); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V xor3(V a, V b, V c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V maj(V a, V b, V c) {
+        return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V ch(V a, V b, V c) {
+        return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_andnot_si256(a, c));
+    }
+    template<int n> SM3_TARGET("avx2") static SM3_FORCEINLINE V rotl(V a) {
+        return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n));
+    }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V set1(uint32_t k) { return _mm256_set1_epi32((int)k); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE V load(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE void store(uint32_t* p, V a) { _mm256_store_si256((__m256i*)p, a); }
+    SM3_TARGET("avx2") static SM3_FORCEINLINE void load_words(const uint8_t* const* blocks, V W[16]) {
+        sm3_load8x8_avx2(blocks, 0, W);
+        sm3_load8x8_avx2(blocks, 32, W + 8);
+    }
+};
+
+// AVX-512：循环移位用 vprold，三输入逻辑各一条 vpternlogd；16 个通道分两半各做一次 8x8 转置后拼接
+struct Sm3Avx512Ops {
+    typedef __m512i V;
+    static const int LANES = 16;
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V add(V a, V b) { return _mm512_add_epi32(a, b); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V x(V a, V b) { return _mm512_xor_si512(a, b); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V xor3(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V maj(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0xE8); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V ch(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0xCA); }
+    template<int n> SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V rotl(V a) { return _mm512_rol_epi32(a, n); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V set1(uint32_t k) { return _mm512_set1_epi32((int)k); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE V load(const uint32_t* p) { return _mm512_load_si512((const void*)p); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE void store(uint32_t* p, V a) { _mm512_store_si512((void*)p, a); }
+    SM3_TARGET("avx512f,avx2") static SM3_FORCEINLINE void load_words(const uint8_t* const* blocks, V W[16]) {
+        __m256i lo[16], hi[16];
+        sm3_load8x8_avx2(blocks, 0, lo);
+        sm3_load8x8_avx2(blocks, 32, lo + 8);
+        sm3_load8x8_avx2(blocks + 8, 0, hi);
+        sm3_load8x8_avx2(blocks + 8, 32, hi + 8);
+        for (int w = 0; w < 16; ++w) W[w] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[w]), hi[w], 1);
+    }
+};
+
+typedef void (*sm3_lanes_fn)(uint32_t S[8][SM3_MB_LANES], const uint8_t* const* blocks);
+
+// 一次压缩 Ops::LANES 个通道各自的一个分组，blocks[l] 为第 l 个通道的 64 字节分组。
+// GCC 只把带 target 属性的内联函数内联进同目标的函数，两个内核共用一份宏定义、各带自己的 target
+#define SM3_MB_ROUND(j, FFJ, GGJ) { \
+        V A12 = Ops::rotl<12>(A); \
+        V SS1 = Ops::rotl<7>(Ops::add(Ops::add(A12, E), Ops::set1(SM3_TJ.k[j]))); \
+        V SS2 = Ops::x(SS1, A12); \
+        V TT1 = Ops::add(Ops::add(FFJ(A, B, C), D), Ops::add(SS2, Ops::x(W[j], W[(j) + 4]))); \
+        V TT2 = Ops::add(Ops::add(GGJ(E, F, G), H), Ops::add(SS1, W[j])); \
+        D = C; C = Ops::rotl<9>(B); B = A; A = TT1; \
+        H = G; G = Ops::rotl<19>(F); F = E; \
+        E = Ops::xor3(TT2, Ops::rotl<9>(TT2), Ops::rotl<17>(TT2)); }
+
+#define SM3_DEFINE_LANES_KERNEL(fn, OPS, isa) \
+SM3_TARGET(isa) void fn(uint32_t S[8][SM3_MB_LANES], const uint8_t* const* blocks) { \
+    typedef OPS Ops; \
+    typedef Ops::V V; \
+    V W[68]; \
+    Ops::load_words(blocks, W); \
+    for (int j = 16; j < 68; ++j) { \
+        V t = Ops::xor3(W[j - 16], W[j - 9], Ops::rotl<15>(W[j - 3])); \
+        t = Ops::xor3(t, Ops::rotl<15>(t), Ops::rotl<23>(t)); \
+        W[j] = Ops::xor3(t, Ops::rotl<7>(W[j - 13]), W[j - 6]); \
+    } \
+    V A = Ops::load(S[0]), B = Ops::load(S[1]), C = Ops::load(S[2]), D = Ops::load(S[3]); \
+    V E = Ops::load(S[4]), F = Ops::load(S[5]), G = Ops::load(S[6]), H = Ops::load(S[7]); \
+    for (int j = 0; j < 16; ++j) SM3_MB_ROUND(j, Ops::xor3, Ops::xor3) \
+    for (int j = 16; j < 64; ++j) SM3_MB_ROUND(j, Ops::maj, Ops::ch) \
+    Ops::store(S[0], Ops::x(A, Ops::load(S[0]))); Ops::store(S[1], Ops::x(B, Ops::load(S[1]))); \
+    Ops::store(S[2], Ops::x(C, Ops::load(S[2]))); Ops::store(S[3], Ops::x(D, Ops::load(S[3]))); \
+    Ops::store(S[4], Ops::x(E, Ops::load(S[4]))); Ops::store(S[5], Ops::x(F, Ops::load(S[5]))); \
+    Ops::store(S[6], Ops::x(G, Ops::load(S[6]))); Ops::store(S[7], Ops::x(H, Ops::load(S[7]))); \
+}
+
+SM3_DEFINE_LANES_KERNEL(sm3_compress_8lanes_avx2, Sm3Avx2Ops, "avx2")
+SM3_DEFINE_LANES_KERNEL(sm3_compress_16lanes_avx512, Sm3Avx512Ops, "avx512f,avx2")
+#undef SM3_DEFINE_LANES_KERNEL
+#undef SM3_MB_ROUND
+
+// 多缓冲内核选择，环境变量 SM3_MB_KERNEL 可强制为 avx512、avx2 或 scalar（逐条 Sm3Ctx）
+struct Sm3LaneKernelInfo {
+    const char* name;
+    uint32_t need;
+    int lanes;
+    sm3_lanes_fn compress;
+};
+static const Sm3LaneKernelInfo SM3_LANE_KERNELS[] = {
+    { "avx512", SM3_CPU_AVX512F | SM3_CPU_AVX2, 16, sm3_compress_16lanes_avx512 },
+    { "avx2", SM3_CPU_AVX2, 8, sm3_compress_8lanes_avx2 },
+    { "scalar", 0, 1, nullptr },
+};
+
+struct SM3_MB_DISPATCH_TABLE {
+    std::once_flag once;
+    const Sm3LaneKernelInfo* kernel = &SM3_LANE_KERNELS[2];
+
+    bool select(const char* name) {
+        bool automatic = name == nullptr || strcmp(name, "auto") == 0;
+        uint32_t cpu = sm3_cpu_features();
+        for (const Sm3LaneKernelInfo& k : SM3_LANE_KERNELS) {
+            if (!automatic && strcmp(name, k.name) != 0) continue;
+            if ((cpu & k.need) != k.need) {
+                if (automatic) continue;
+                return false;
+            }
+            kernel = &k;
+            return true;
+        }
+        return false;
+    }
+
+    void init() {
+        std::call_once(once, [this] {
+            SM3_DISPATCH.init();
+            const char* env = getenv("SM3_MB_KERNEL");
+            if (env && *env && select(env)) return;
+            if (env && *env) cerr << "SM3_MB_KERNEL=" << env << " 未知或本机不支持，改为自动选择" << endl;
+            select(nullptr);
+        });
+    }
+} SM3_MB_DISPATCH;
+
+struct Sm3Job {
+    const uint8_t* msg;
+    size_t len;
+    uint8_t* digest;    // 32 字节
+};
+
+// 消息的最后 1~2 个分组：不足 64 字节的尾部、0x80、补 0 与 64 位大端比特长度，返回分组数
+static int sm3_pad_tail(const uint8_t* tail, size_t tail_len, uint64_t total, uint8_t out[128]) {
+    int nb = tail_len < 56 ? 1 : 2;
+    memset(out, 0, 64 * nb);
+    if (tail_len) memcpy(out, tail, tail_len);
+    out[tail_len] = 0x80;
+    uint64_t bits = total * 8;
+    for (int i = 0; i < 8; ++i) out[64 * nb - 8 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    return nb;
+}
+
+// 调度：每个通道持有一条消息，每轮各取下一个分组（先是消息中的整块，直接指向调用方缓冲区，
+// 然后是通道自己的填充分组）交给内核；一条消息做完即写出摘要并接下一条，长短不一的消息也能让
+// 通道保持满载。没有新消息且剩余通道不足一半时，剩下的消息改用单条压缩函数做完。
+void sm3_digest_multi(const Sm3Job* jobs, size_t njobs) {
+    SM3_MB_DISPATCH.init();
+    const Sm3LaneKernelInfo* k = SM3_MB_DISPATCH.kernel;
+    if (k->lanes == 1) {
+        for (size_t i = 0; i < njobs; ++i) {
+            array<uint8_t, 32> d = sm3_digest(jobs[i].msg, jobs[i].len);
+            memcpy(jobs[i].digest, d.data(), 32);
+        }
+        return;
+    }
+    const int L = k->lanes;
+    struct Lane {
+        const Sm3Job* job;
+        const uint8_t* p;       // 下一个整块
+        size_t full;            // 剩余整块数
+        int pad_next, pad_count;
+        alignas(64) uint8_t pad[128];
+    };
+    Lane lane[SM3_MB_LANES];
+    alignas(64) uint32_t S[8][SM3_MB_LANES];
+    static const uint8_t idle[64] = { 0 };
+    const uint8_t* blocks[SM3_MB_LANES];
+    for (int l = 0; l < L; ++l) lane[l].job = nullptr;
+    size_t next = 0;
+
+    auto start_job = [&](int l, const Sm3Job* j) {
+        Lane& ln = lane[l];
+        ln.job = j;
+        ln.p = j->msg;
+        ln.full = j->len / 64;
+        ln.pad_next = 0;
+        ln.pad_count = sm3_pad_tail(j->msg + 64 * ln.full, j->len % 64, j->len, ln.pad);
+        for (int i = 0; i < 8; ++i) S[i][l] = IV[i];
+    };
+    auto write_digest = [&](int l, const uint32_t* V, int stride) {
+        uint8_t* d = lane[l].job->digest;
+        for (int i = 0; i < 8; ++i) {
+            uint32_t v = V[i * stride];
+            d[4 * i] = (v >> 24) & 0xFF;
+            d[4 * i + 1] = (v >> 16) & 0xFF;
+            d[4 * i + 2] = (v >> 8) & 0xFF;
+            d[4 * i + 3] = v & 0xFF;
+        }
+        lane[l].job = nullptr;
+    };
+
+    for (;;) {
+        int active = 0;
+        for (int l = 0; l < L; ++l) {
+            if (!lane[l].job && next < njobs) start_job(l, &jobs[next++]);
+            if (lane[l].job) ++active;
+        }
+        if (active == 0) break;
+        if (next == njobs && 2 * active < L) {
+            // 收尾：剩余通道逐条做完
+            for (int l = 0; l < L; ++l) {
+                Lane& ln = lane[l];
+                if (!ln.job) continue;
+                uint32_t V[8];
+                for (int i = 0; i < 8; ++i) V[i] = S[i][l];
+                if (ln.full) SM3_DISPATCH.compress(V, ln.p, ln.full);
+                SM3_DISPATCH.compress(V, ln.pad + 64 * ln.pad_next, ln.pad_count - ln.pad_next);
+                write_digest(l, V, 1);
+            }
+            break;
+        }
+        for (int l = 0; l < L; ++l) {
+            Lane& ln = lane[l];
+            if (!ln.job) blocks[l] = idle;
+            else if (ln.full) {
+                blocks[l] = ln.p;
+                ln.p += 64;
+                --ln.full;
+            } else blocks[l] = ln.pad + 64 * ln.pad_next++;
+        }
+        k->compress(S, blocks);
+        for (int l = 0; l < L; ++l)
+            if (lane[l].job && lane[l].full == 0 && lane[l].pad_next == lane[l].pad_count)
+                write_digest(l, &S[0][l], SM3_MB_LANES);
+    }
+}
+
+// 标准测试向量（GB/T 32905 附录 A："abc" 与 64 字节的 "abcd" x 16），以及任意切分送入
+// Sm3Ctx 与 sm3_standard 一致（长度覆盖 55/56/63/64 字节等填充边界）
+bool sm3_ctx_self_test() {
+    static const uint8_t abc_hash[32] = {
+        0x66,0xc7,0xf0,0xf4,0x62,0xee,0xed,0xd9,0xd1,0xf2,0xd4,0x6b,0xdc,0x10,0xe4,0xe2,
+        0x41,0x67,0xc4,0x87,0x5c,0xf2,0xf7,0xa2,0x29,0x7d,0xa0,0x2b,0x8f,0x4b,0xa8,0xe0 };
+    static const uint8_t abcd_hash[32] = {
+        0xde,0xbe,0x9f,0xf9,0x22,0x75,0xb8,0xa1,0x38,0x60,0x48,0x89,0xc1,0x8e,0x5a,0x4d,
+        0x6f,0xdb,0x70,0xe5,0x38,0x7e,0x57,0x65,0x29,0x3d,0xcb,0xa3,0x9c,0x0c,0x57,0x32 };
+    array<uint8_t, 32> d = sm3_digest((const uint8_t*)"abc", 3);
+    if (memcmp(d.data(), abc_hash, 32) != 0) return false;
+    string abcd;
+    for (int i = 0; i < 16; ++i) abcd += "abcd";
+    d = sm3_digest((const uint8_t*)abcd.data(), abcd.size());
+    if (memcmp(d.data(), abcd_hash, 32) != 0) return false;
+
+    vector<uint8_t> msg(1000);
+    for (size_t i = 0; i < msg.size(); ++i) msg[i] = (uint8_t)(i * 37 + 11);
+    const size_t steps[] = { 1, 3, 63, 64, 65, 200 };
+    for (size_t len = 0; len <= msg.size(); len += (len < 130 ? 1 : 97)) {
+        vector<uint8_t> m(msg.begin(), msg.begin() + len);
+        vector<uint8_t> ref = sm3_standard(m);
+        for (size_t step : steps) {
+            Sm3Ctx ctx;
+            for (size_t off = 0; off < len; off += step) ctx.update(m.data() + off, min(step, len - off));
+            ctx.final(d);
+            if (memcmp(d.data(), ref.data(), 32) != 0) return false;
+        }
+        if (sm3_optimized(m) != ref) return false;
+    }
+    return true;
+}
+
+// 多缓冲：长度 0~300 与若干多分组长度混在一批，逐条与标准实现比对；每个本机支持的内核各测一遍
+bool sm3_multi_self_test() {
+    vector<vector<uint8_t>> msgs;
+    for (size_t len = 0; len <= 300; ++len) msgs.emplace_back(len);
+    const size_t longer[] = { 1000, 4095, 4096, 10000, 1, 55, 56 };
+    for (size_t len : longer) msgs.emplace_back(len);
+    for (size_t i = 0; i < msgs.size(); ++i)
+        for (size_t j = 0; j < msgs[i].size(); ++j) msgs[i][j] = (uint8_t)(i * 131 + j * 7 + 3);
+    vector<uint8_t> out(32 * msgs.size());
+    vector<Sm3Job> jobs(msgs.size());
+    for (size_t i = 0; i < msgs.size(); ++i) jobs[i] = { msgs[i].data(), msgs[i].size(), &out[32 * i] };
+
+    SM3_MB_DISPATCH.init();
+    const Sm3LaneKernelInfo* saved = SM3_MB_DISPATCH.kernel;
+    bool ok = true;
+    for (const Sm3LaneKernelInfo& k : SM3_LANE_KERNELS) {
+        if (!SM3_MB_DISPATCH.select(k.name)) continue;
+        fill(out.begin(), out.end(), 0);
+        sm3_digest_multi(jobs.data(), jobs.size());
+        for (size_t i = 0; i < msgs.size() && ok; ++i)
+            ok = memcmp(sm3_standard(msgs[i]).data(), &out[32 * i], 32) == 0;
+    }
+    SM3_MB_DISPATCH.kernel = saved;
+    return ok;
+}
+
+// 测试函数
+void benchmark() {
+    // 生成1MB测试数据
+    const size_t DATA_SIZE = 1024 * 1024;
+    vector<uint8_t> data(DATA_SIZE, 0xAA);  // 填充测试数据
+
+    // 标准实现测试
+    auto start = high_resolution_clock::now();
+    auto hash1 = sm3_standard(data);
+    auto end = high_resolution_clock::now();
+    double time_std = duration<double, milli>(end - start).count();
+    double throughput_std = (DATA_SIZE / 1024.0 / 1024.0) / (time_std / 1000.0);
+
+    // 优化实现测试
+    start = high_resolution_clock::now();
+    auto hash2 = sm3_optimized(data);
+    end = high_resolution_clock::now();
+    double time_opt = duration<double, milli>(end - start).count();
+    double throughput_opt = (DATA_SIZE / 1024.0 / 1024.0) / (time_opt / 1000.0);
+
+    // 输出结果
+    cout << "=== SM3效率对比测试 ===" << endl;
+    cout << "数据大小: " << DATA_SIZE / 1024 << "KB" << endl;
+    cout << "标准实现: " << fixed << setprecision(2)
+        << time_std << "ms, 吞吐量: " << throughput_std << "MB/s" << endl;
+    cout << "优化实现: " << fixed << setprecision(2)
+        << time_opt << "ms, 吞吐量: " << throughput_opt << "MB/s" << endl;
+    cout << "优化倍数: " << fixed << setprecision(2) << (throughput_opt / throughput_std) << "x" << endl;
+    cout << "压缩函数: " << SM3_DISPATCH.kernel->name << endl;
+    cout << "结果一致: " << (hash1 == hash2 ? "是" : "否") << endl;
+
+    // 大数据分段送入：每次 64KB，内存占用只有上下文本身
+    const size_t STREAM_SIZE = 256u << 20, PIECE = 64 * 1024;
+    vector<uint8_t> piece(PIECE, 0x5A);
+    start = high_resolution_clock::now();
+    Sm3Ctx ctx;
+    for (size_t off = 0; off < STREAM_SIZE; off += PIECE) ctx.update(piece.data(), PIECE);
+    array<uint8_t, 32> digest;
+    ctx.final(digest);
+    end = high_resolution_clock::now();
+    double time_stream = duration<double, milli>(end - start).count();
+    cout << "流式 Sm3Ctx: " << STREAM_SIZE / (1024 * 1024) << "MB 分 " << PIECE / 1024 << "KB 送入, "
+        << (STREAM_SIZE / 1024.0 / 1024.0) / (time_stream / 1000.0) << "MB/s" << endl;
+
+    // 大量短消息（Merkle 节点、去重指纹）：每条都复制并返回 vector 与写入定长数组
+    const size_t SMALL = 100000;
+    vector<uint8_t> small_msg(65, 0x3C);
+    volatile uint8_t sink = 0;
+    start = high_resolution_clock::now();
+    for (size_t i = 0; i < SMALL; ++i) {
+        small_msg[0] = (uint8_t)i;
+        sink = sink ^ sm3_standard(small_msg)[0];
+    }
+    end = high_resolution_clock::now();
+    double time_vec = duration<double, milli>(end - start).count();
+    start = high_resolution_clock::now();
+    for (size_t i = 0; i < SMALL; ++i) {
+        small_msg[0] = (uint8_t)i;
+        sink = sink ^ sm3_digest(small_msg.data(), small_msg.size())[0];
+    }
+    end = high_resolution_clock::now();
+    double time_arr = duration<double, milli>(end - start).count();
+    cout << "65 字节消息 x" << SMALL << ": 标准实现 " << setprecision(0) << SMALL / (time_vec / 1000.0)
+        << " 个/秒, Sm3Ctx " << SMALL / (time_arr / 1000.0) << " 个/秒 (" << setprecision(2)
+        << time_vec / time_arr << "x)" << endl;
+    cout << "Sm3Ctx 测试向量与任意切分: " << (sm3_ctx_self_test() ? "通过" : "失败") << endl;
+
+    // 多缓冲：同一批 4096 条等长消息，逐条 sm3_digest 与 sm3_digest_multi 的每秒哈希数
+    SM3_MB_DISPATCH.init();
+    cout << "多缓冲内核: " << SM3_MB_DISPATCH.kernel->name << " (" << SM3_MB_DISPATCH.kernel->lanes << " 通道)" << endl;
+    const size_t BATCH = 4096, ROUNDS = 16;
+    const size_t mb_lens[] = { 9, 65, 1024 };
+    for (size_t len : mb_lens) {
+        vector<uint8_t> msgs(BATCH * len), out(32 * BATCH);
+        for (size_t i = 0; i < msgs.size(); ++i) msgs[i] = (uint8_t)(i * 29 + len);
+        vector<Sm3Job> jobs(BATCH);
+        for (size_t i = 0; i < BATCH; ++i) jobs[i] = { &msgs[i * len], len, &out[32 * i] };
+        start = high_resolution_clock::now();
+        for (size_t r = 0; r < ROUNDS; ++r)
+            for (size_t i = 0; i < BATCH; ++i) sink = sink ^ sm3_digest(&msgs[i * len], len)[0];
+        end = high_resolution_clock::now();
+        double time_one = duration<double, milli>(end - start).count();
+        start = high_resolution_clock::now();
+        for (size_t r = 0; r < ROUNDS; ++r) sm3_digest_multi(jobs.data(), BATCH);
+        end = high_resolution_clock::now();
+        double time_multi = duration<double, milli>(end - start).count();
+        bool same = true;
+        for (size_t i = 0; i < BATCH && same; ++i)
+            same = memcmp(sm3_digest(&msgs[i * len], len).data(), &out[32 * i], 32) == 0;
+        cout << setw(4) << len << " 字节消息 x" << BATCH << ": 逐条 " << setprecision(0)
+            << BATCH * ROUNDS / (time_one / 1000.0) << " 个/秒, 多缓冲 " << BATCH * ROUNDS / (time_multi / 1000.0)
+            << " 个/秒 (" << setprecision(2) << time_one / time_multi << "x)" << (same ? "" : " 结果不一致") << endl;
+    }
+    cout << "多缓冲与标准实现比对（各内核，0~10000 字节混合）: " << (sm3_multi_self_test() ? "通过" : "失败") << endl;
+}
+
+int main() {
+    benchmark();
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,301 @@
+// SM3 压缩函数、运行时内核选择与流式接口 Sm3Ctx，供 sm3.cpp、markle.cpp 与 长度扩展.cpp 共用
+// （函数与调度表都是 inline，可被同一程序的多个翻译单元包含）。填充与摘要输出只在这里实现一份。
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <mutex>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// 常量定义
+const uint32_t IV[8] = {
+    0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
+    0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
+};
+
+const uint32_t T[64] = {
+    0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519,
+    0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519, 0x79CC4519,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A,
+    0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A, 0x7A879D8A
+};
+
+// 辅助函数
+inline uint32_t ROTL32(uint32_t x, int n) {
+    n &= 31;
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t P0(uint32_t x) {
+    return x ^ ROTL32(x, 9) ^ ROTL32(x, 17);
+}
+
+inline uint32_t P1(uint32_t x) {
+    return x ^ ROTL32(x, 15) ^ ROTL32(x, 23);
+}
+
+inline uint32_t FF(uint32_t x, uint32_t y, uint32_t z, int j) {
+    if (j < 16) return x ^ y ^ z;
+    else return (x & y) | (x & z) | (y & z);
+}
+
+inline uint32_t GG(uint32_t x, uint32_t y, uint32_t z, int j) {
+    if (j < 16) return x ^ y ^ z;
+    else return (x & y) | ((~x) & z);
+}
+
+// 压缩函数：对 nblocks 个 512 比特分组依次迭代，V 为链接变量。
+// 函数体强制内联到各个入口，再按入口的目标指令集分别编译
+#if defined(_MSC_VER)
+#define SM3_FORCEINLINE __forceinline
+#define SM3_TARGET(isa)
+#else
+#define SM3_FORCEINLINE inline __attribute__((always_inline))
+#define SM3_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+static SM3_FORCEINLINE void sm3_compress_body(uint32_t V[8], const uint8_t* p, size_t nblocks) {
+    for (size_t i = 0; i < nblocks; ++i, p += 64) {
+        // 3.1 消息扩展（优化：减少数组访问）
+        uint32_t W[68], W1[64];
+        for (int j = 0; j < 16; ++j) {
+            W[j] = ((uint32_t)p[4 * j] << 24) | ((uint32_t)p[4 * j + 1] << 16) |
+                ((uint32_t)p[4 * j + 2] << 8) | p[4 * j + 3];
+        }
+
+        // 优化：使用局部变量缓存常用值
+        for (int j = 16; j < 68; ++j) {
+            const uint32_t w16 = W[j - 16];
+            const uint32_t w9 = W[j - 9];
+            const uint32_t w3 = ROTL32(W[j - 3], 15);
+            const uint32_t w13 = ROTL32(W[j - 13], 7);
+            const uint32_t w6 = W[j - 6];
+            W[j] = P1(w16 ^ w9 ^ w3) ^ w13 ^ w6;
+        }
+
+        for (int j = 0; j < 64; ++j) {
+            W1[j] = W[j] ^ W[j + 4];
+        }
+
+        // 3.2 迭代压缩（优化：4轮合并）
+        uint32_t A = V[0], B = V[1], C = V[2], D = V[3];
+        uint32_t E = V[4], F = V[5], G = V[6], H = V[7];
+
+        // 宏定义4轮组合操作
+#define ROUND(j) \
+            SS1 = ROTL32(ROTL32(A, 12) + E + ROTL32(T[j], j), 7); \
+            SS2 = SS1 ^ ROTL32(A, 12); \
+            TT1 = FF(A, B, C, j) + D + SS2 + W1[j]; \
+            TT2 = GG(E, F, G, j) + H + SS1 + W[j]; \
+            D = C; C = ROTL32(B, 9); B = A; A = TT1; \
+            H = G; G = ROTL32(F, 19); F = E; E = P0(TT2);
+
+        // 批量处理64轮（每4轮一组）；宏内多次用到 j，不能写成 ROUND(j++)
+        for (int j = 0; j < 64; j += 4) {
+            uint32_t SS1, SS2, TT1, TT2;
+            ROUND(j);
+            ROUND(j + 1);
+            ROUND(j + 2);
+            ROUND(j + 3);
+        }
+#undef ROUND
+
+        // 3.3 更新哈希值
+        V[0] ^= A; V[1] ^= B; V[2] ^= C; V[3] ^= D;
+        V[4] ^= E; V[5] ^= F; V[6] ^= G; V[7] ^= H;
+    }
+}
+
+typedef void (*sm3_compress_fn)(uint32_t V[8], const uint8_t* blocks, size_t nblocks);
+
+inline void sm3_compress_generic(uint32_t V[8], const uint8_t* blocks, size_t nblocks) {
+    sm3_compress_body(V, blocks, nblocks);
+}
+
+// BMI2 的 RORX 不改标志位、不覆盖源操作数，循环移位密集的压缩函数可以少掉大量 mov
+SM3_TARGET("bmi2") inline void sm3_compress_bmi2(uint32_t V[8], const uint8_t* blocks, size_t nblocks) {
+    sm3_compress_body(V, blocks, nblocks);
+}
+
+// CPU 特性探测，只执行一次
+enum : uint32_t {
+    SM3_CPU_BMI2 = 1u << 0,
+    SM3_CPU_AVX2 = 1u << 1,
+    SM3_CPU_AVX512F = 1u << 2,
+};
+
+static uint32_t sm3_cpu_probe() {
+    uint32_t r[4] = { 0 }, f = 0;
+#if defined(_MSC_VER)
+    __cpuidex((int*)r, 0, 0);
+#else
+    __cpuid_count(0, 0, r[0], r[1], r[2], r[3]);
+#endif
+    if (r[0] < 7) return 0;
+#if defined(_MSC_VER)
+    __cpuidex((int*)r, 1, 0);
+    bool osxsave = (r[2] & (1u << 27)) != 0;
+    uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex((int*)r, 7, 0);
+#else
+    __cpuid_count(1, 0, r[0], r[1], r[2], r[3]);
+    bool osxsave = (r[2] & (1u << 27)) != 0;
+    uint64_t xcr0 = 0;
+    if (osxsave) {
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+    }
+    __cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+    if (r[1] & (1u << 8)) f |= SM3_CPU_BMI2;
+    if ((xcr0 & 0x06) == 0x06 && (r[1] & (1u << 5))) f |= SM3_CPU_AVX2;
+    if ((xcr0 & 0xE6) == 0xE6 && (r[1] & (1u << 16))) f |= SM3_CPU_AVX512F;
+    return f;
+}
+
+static inline uint32_t sm3_cpu_features() {
+    static const uint32_t features = sm3_cpu_probe();
+    return features;
+}
+
+// 压缩函数的运行时选择，环境变量 SM3_KERNEL 可强制为 bmi2 或 generic
+struct Sm3KernelInfo {
+    const char* name;
+    uint32_t need;
+    sm3_compress_fn compress;
+};
+static const Sm3KernelInfo SM3_KERNELS[] = {
+    { "bmi2", SM3_CPU_BMI2, sm3_compress_bmi2 },
+    { "generic", 0, sm3_compress_generic },
+};
+
+// 初值为 generic，init 由 call_once 保证只执行一次，多线程同时首次使用也安全
+struct SM3_DISPATCH_TABLE {
+    std::once_flag once;
+    const Sm3KernelInfo* kernel = &SM3_KERNELS[1];
+    sm3_compress_fn compress = sm3_compress_generic;
+
+    bool select(const char* name) {
+        bool automatic = name == nullptr || strcmp(name, "auto") == 0;
+        uint32_t cpu = sm3_cpu_features();
+        for (const Sm3KernelInfo& k : SM3_KERNELS) {
+            if (!automatic && strcmp(name, k.name) != 0) continue;
+            if ((cpu & k.need) != k.need) {
+                if (automatic) continue;
+                return false;
+            }
+            kernel = &k;
+            compress = k.compress;
+            return true;
+        }
+        return false;
+    }
+
+    void init() {
+        std::call_once(once, [this] {
+            const char* env = getenv("SM3_KERNEL");
+            if (env && *env && select(env)) return;
+            if (env && *env) fprintf(stderr, "SM3_KERNEL=%s 未知或本机不支持，改为自动选择\n", env);
+            select(nullptr);
+        });
+    }
+};
+inline SM3_DISPATCH_TABLE SM3_DISPATCH;
+
+// 流式 SM3：update 直接从调用方的缓冲区压缩整块，只在 buf 中保留不足 64 字节的尾部，
+// 不分配内存也不拷贝整条消息，任意大的数据可以分段送入；final 写出摘要后需重新 init 才能再用
+struct Sm3Ctx {
+    uint32_t V[8];
+    uint8_t buf[64];
+    size_t buf_len;
+    uint64_t total;     // 已送入的字节数（resume 时含之前的填充，决定最后长度字段的值）
+
+    Sm3Ctx() { init(); }
+
+    void init() {
+        SM3_DISPATCH.init();
+        memcpy(V, IV, sizeof(V));
+        buf_len = 0;
+        total = 0;
+    }
+
+    // 从链接变量继续：state 为处理完 processed 字节（64 的倍数）后的状态。
+    // 摘要就是最后的链接变量，长度扩展攻击正是利用这一点（见 长度扩展.cpp）
+    void resume(const uint32_t state[8], uint64_t processed) {
+        SM3_DISPATCH.init();
+        memcpy(V, state, sizeof(V));
+        buf_len = 0;
+        total = processed;
+    }
+
+    void update(const uint8_t* p, size_t n) {
+        total += n;
+        if (buf_len) {
+            size_t k = n < 64 - buf_len ? n : 64 - buf_len;
+            memcpy(buf + buf_len, p, k);
+            buf_len += k; p += k; n -= k;
+            if (buf_len < 64) return;
+            SM3_DISPATCH.compress(V, buf, 1);
+            buf_len = 0;
+        }
+        if (n >= 64) {
+            SM3_DISPATCH.compress(V, p, n / 64);
+            p += n / 64 * 64;
+            n %= 64;
+        }
+        if (n) {
+            memcpy(buf, p, n);
+            buf_len = n;
+        }
+    }
+
+    void update(const std::vector<uint8_t>& v) { update(v.data(), v.size()); }
+
+    // 填充 0x80、若干 0 与 64 位大端比特长度，尾部放不下长度时多压缩一块
+    void final(std::array<uint8_t, 32>& digest) {
+        uint64_t bits = total * 8;
+        buf[buf_len++] = 0x80;
+        if (buf_len > 56) {
+            memset(buf + buf_len, 0, 64 - buf_len);
+            SM3_DISPATCH.compress(V, buf, 1);
+            buf_len = 0;
+        }
+        memset(buf + buf_len, 0, 56 - buf_len);
+        for (int i = 0; i < 8; ++i) buf[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+        SM3_DISPATCH.compress(V, buf, 1);
+        for (int i = 0; i < 8; ++i) {
+            digest[4 * i] = (V[i] >> 24) & 0xFF;
+            digest[4 * i + 1] = (V[i] >> 16) & 0xFF;
+            digest[4 * i + 2] = (V[i] >> 8) & 0xFF;
+            digest[4 * i + 3] = V[i] & 0xFF;
+        }
+    }
+
+    // 以 vector 保存摘要的调用方（如 Merkle 树的节点）
+    std::vector<uint8_t> final() {
+        std::array<uint8_t, 32> d;
+        final(d);
+        return std::vector<uint8_t>(d.begin(), d.end());
+    }
+};
+
+// 一次性接口：摘要写入定长数组，不经过堆
+inline std::array<uint8_t, 32> sm3_digest(const uint8_t* msg, size_t len) {
+    Sm3Ctx ctx;
+    ctx.update(msg, len);
+    std::array<uint8_t, 32> digest;
+    ctx.final(digest);
+    return digest;
+}